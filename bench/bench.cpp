@@ -0,0 +1,560 @@
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.hpp>
+#include <VkBootstrap.h>
+#include <fmt/base.h>
+#include <fmt/format.h>
+//
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+//
+#include "audio.hpp"
+#include "capture.hpp"
+#include "renderer.hpp"
+#include "vk_wrappers/memory.hpp"
+#include "vk_wrappers/queues.hpp"
+#include "vk_wrappers/tasks.hpp"
+
+// headless benchmark: renders each scene/resolution pair for a fixed number of frames
+// usage: vulkan-renderer-bench [--scenes a,b] [--res 1280x720,1920x1080] [--frames N] [--warmup N]
+//                              [--output out.json] [--baseline base.json] [--threshold 0.1]
+//                              [--software] [--validation] [--mesh model.mesh] [--texture detail.ktx2]
+//                              [--upload auto|direct|staging]
+// the capture scene is not run by default, it reports frames dropped by the readback encoder
+// upload mode: vulkan-renderer-bench --uploads N [--mesh model.mesh] [--texture detail.ktx2] [--output out.json]
+//              compares the time until scene resources are ready through staging copies and written in place
+// audio mode: vulkan-renderer-bench --audio N [--audio-period frames] [--audio-streams N] [--output out.json]
+//             mixes N looping voices without a device, then runs the mixer callback on miniaudio's null backend
+//             and streams a generated 10 s wav file N times at once
+// startup mode: vulkan-renderer-bench --startup N [--exe path/to/vulkan-renderer] [--output out.json]
+//               launches the renderer N times and reports the distribution of each startup stage
+
+struct Options {
+    std::vector<std::string> scenes = { "gradient", "meshes", "postprocess" };
+    std::vector<vk::Extent2D> resolutions = { { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+    uint32_t nFrames = 500;
+    uint32_t nWarmup = 50;
+    std::string outputPath;
+    std::string baselinePath;
+    float threshold = 0.1f; // allowed relative slowdown before a run counts as regression
+    bool bSoftware = false; // prefer cpu (software icd) devices, e.g. lavapipe
+    bool bValidation = false;
+    std::string meshPath; // mesh file used by the mesh scenes
+    std::string texturePath; // ktx2 detail texture used by the mesh scenes
+    std::string uploadPath = "auto"; // direct on unified memory devices, else staging
+    uint32_t nStartupRuns = 0; // when set, measure renderer startup instead of frame times
+    uint32_t nUploadRuns = 0; // when set, compare upload paths instead of frame times
+    uint32_t nAudioVoices = 0; // when set, measure the audio mixer instead of frame times
+    uint32_t audioPeriod = 256;
+    uint32_t nAudioStreams = 32;
+    std::string executable;
+};
+struct Scene {
+    std::string_view name;
+    std::function<void(Renderer&)> setup; // applied after Renderer::init
+    bool bCapture = false; // read back and encode every frame into a temporary y4m file
+};
+static const std::vector<Scene> scenes = {
+    { "gradient", [](Renderer& renderer) {
+        renderer.bMeshes = false;
+        for (auto& pass : renderer.postProcess.passes) pass.bEnabled = false;
+    }},
+    { "meshes", [](Renderer& renderer) {
+        for (auto& pass : renderer.postProcess.passes) pass.bEnabled = false;
+    }},
+    { "meshes_unculled", [](Renderer& renderer) {
+        renderer.bCulling = false;
+        for (auto& pass : renderer.postProcess.passes) pass.bEnabled = false;
+    }},
+    { "postprocess", [](Renderer&) {} },
+    { "capture", [](Renderer&) {}, true },
+};
+
+struct Percentiles {
+    Percentiles(std::vector<float> samples) {
+        if (samples.empty()) return;
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](float p) { return samples[(size_t)(p * (samples.size() - 1))]; };
+        p50 = at(0.50f);
+        p90 = at(0.90f);
+        p99 = at(0.99f);
+        max = samples.back();
+        for (float sample : samples) mean += sample;
+        mean /= samples.size();
+    }
+    std::string to_json() const {
+        return fmt::format("{{\"p50\": {:.4f}, \"p90\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f}, \"mean\": {:.4f}}}", p50, p90, p99, max, mean);
+    }
+    float p50 = 0, p90 = 0, p99 = 0, max = 0, mean = 0;
+};
+struct Run {
+    std::string to_json() const {
+        return fmt::format("{{\"scene\": \"{}\", \"width\": {}, \"height\": {}, \"frames\": {}, \"dropped\": {}, \"cpu_ms\": {}, \"gpu_ms\": {}, \"memory\": {{\"allocation_bytes\": {}, \"block_bytes\": {}}}}}",
+            scene, extent.width, extent.height, nFrames, nDropped, cpu.to_json(), gpu.to_json(), allocationBytes, blockBytes);
+    }
+    std::string scene;
+    vk::Extent2D extent;
+    uint32_t nFrames;
+    uint32_t nDropped = 0; // frames the capture could not keep up with
+    Percentiles cpu = std::vector<float>();
+    Percentiles gpu = std::vector<float>();
+    vk::DeviceSize allocationBytes = 0;
+    vk::DeviceSize blockBytes = 0;
+};
+
+struct UploadRun {
+    std::string to_json() const {
+        return fmt::format("{{\"path\": \"{}\", \"cpu_ms\": {}, \"ready_ms\": {}, \"allocation_bytes\": {}}}", path, cpu.to_json(), ready.to_json(), allocationBytes);
+    }
+    std::string path;
+    Percentiles cpu = std::vector<float>(); // filling device or staging memory
+    Percentiles ready = std::vector<float>(); // until the uploaded resources can be used by the gpu
+    vk::DeviceSize allocationBytes = 0;
+};
+
+struct Headless {
+    Headless(const Options& options) {
+        // Vulkan: dynamic dispatcher init 1/3
+        VULKAN_HPP_DEFAULT_DISPATCHER.init();
+
+        // VkBootstrap: create vulkan instance without any surface extensions
+        vkb::InstanceBuilder builder;
+        builder.set_app_name("Vulkan Renderer Bench")
+            .set_headless(true)
+            .require_api_version(1, 3, 0);
+        if (options.bValidation) builder.request_validation_layers().use_default_debug_messenger();
+        auto instanceBuild = builder.build();
+        if (!instanceBuild) fmt::println("VkBootstrap error: {}", instanceBuild.error().message());
+        vkb::Instance instanceVkb = instanceBuild.value();
+        instance = vk::raii::Instance(context, instanceVkb);
+        if (options.bValidation) debugMsg = vk::raii::DebugUtilsMessengerEXT(instance, instanceVkb.debug_messenger);
+
+        // Vulkan: dynamic dispatcher init 2/3
+        VULKAN_HPP_DEFAULT_DISPATCHER.init(*instance);
+
+        // VkBootstrap: select physical device
+        vkb::PhysicalDeviceSelector selector(instanceVkb);
+        selector.set_minimum_version(1, 3)
+            .add_required_extension(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME)
+            .prefer_gpu_device_type(options.bSoftware ? vkb::PreferredDeviceType::cpu : vkb::PreferredDeviceType::discrete)
+            .allow_any_gpu_device_type(true)
+            .set_required_features_11(vk::PhysicalDeviceVulkan11Features())
+            .set_required_features_12(vk::PhysicalDeviceVulkan12Features()
+                .setTimelineSemaphore(true)
+                .setBufferDeviceAddress(true)
+                .setDescriptorIndexing(true))
+            .set_required_features_13(vk::PhysicalDeviceVulkan13Features()
+                .setDynamicRendering(true)
+                .setSynchronization2(true));
+        auto deviceSelection = selector.select();
+        if (!deviceSelection) fmt::println("VkBootstrap error: {}", deviceSelection.error().message());
+        vkb::PhysicalDevice physicalDeviceVkb = deviceSelection.value();
+        // optional: mesh batches are drawn with one indirect call per pipeline
+        physicalDeviceVkb.enable_features_if_present(vk::PhysicalDeviceFeatures()
+            .setMultiDrawIndirect(true)
+            .setSamplerAnisotropy(true)
+            .setTextureCompressionBC(true));
+        physicalDeviceVkb.enable_extension_features_if_present(vk::PhysicalDeviceVulkan12Features()
+            .setDrawIndirectCount(true));
+        physDevice = vk::raii::PhysicalDevice(instance, physicalDeviceVkb);
+        bUnified = Memory::is_unified(physDevice);
+        bDirectUploads = options.uploadPath == "direct" || (options.uploadPath == "auto" && bUnified);
+        fmt::println("bench device: {} ({} memory, {} uploads)", physicalDeviceVkb.name, bUnified ? "unified" : "dedicated", bDirectUploads ? "direct" : "staging");
+
+        // VkBootstrap: create device
+        auto deviceBuilder = vkb::DeviceBuilder(physicalDeviceVkb).build();
+        if (!deviceBuilder) fmt::println("VkBootstrap error: {}", deviceBuilder.error().message());
+        vkb::Device deviceVkb = deviceBuilder.value();
+        device = vk::raii::Device(physDevice, deviceVkb);
+
+        // Vulkan: dynamic dispatcher init 3/3
+        VULKAN_HPP_DEFAULT_DISPATCHER.init(*device);
+
+        // VMA: create allocator
+        vma::VulkanFunctions vulkanFuncs(VULKAN_HPP_DEFAULT_DISPATCHER.vkGetInstanceProcAddr, VULKAN_HPP_DEFAULT_DISPATCHER.vkGetDeviceProcAddr);
+        vma::AllocatorCreateInfo allocInfo = vma::AllocatorCreateInfo()
+            .setFlags(vma::AllocatorCreateFlagBits::eBufferDeviceAddress | vma::AllocatorCreateFlagBits::eKhrDedicatedAllocation)
+            .setVulkanApiVersion(vk::ApiVersion13)
+            .setPVulkanFunctions(&vulkanFuncs)
+            .setPhysicalDevice(*physDevice)
+            .setInstance(*instance)
+            .setDevice(*device);
+        alloc = vma::createAllocatorUnique(allocInfo);
+
+        // create command queues
+        queues.init(device, deviceVkb);
+    }
+    Run run(const Scene& scene, vk::Extent2D extent, const Options& options) {
+        Run result = { .scene = std::string(scene.name), .extent = extent, .nFrames = options.nFrames };
+        Tasks::Scheduler tasks; // resumes capture readbacks, outlives the capture
+        Capture capture;
+        Renderer renderer;
+        renderer.meshPath = options.meshPath;
+        renderer.texturePath = options.texturePath;
+        renderer.bDirectUploads = bDirectUploads;
+        renderer.init(physDevice, device, alloc, queues, extent);
+        scene.setup(renderer);
+        std::filesystem::path capturePath = std::filesystem::temp_directory_path() / "vulkan-renderer-bench.y4m";
+        if (scene.bCapture) renderer.start_capture(capture, physDevice, device, alloc, tasks, capturePath.string());
+
+        // render frames, only timing those after warmup
+        std::vector<float> cpuTimes, gpuTimes;
+        cpuTimes.reserve(options.nFrames);
+        gpuTimes.reserve(options.nFrames);
+        uint32_t nDroppedWarmup = 0;
+        for (uint32_t i = 0; i < options.nWarmup + options.nFrames; i++) {
+            if (i == options.nWarmup) nDroppedWarmup = capture.nDropped;
+            auto start = std::chrono::steady_clock::now();
+            renderer.render(device, queues);
+            tasks.poll();
+            auto end = std::chrono::steady_clock::now();
+            if (i < options.nWarmup) continue;
+            cpuTimes.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+            // gpu timestamps lag behind by the number of frames in flight
+            if (renderer.gpuTime > 0.0f) gpuTimes.push_back(renderer.gpuTime);
+        }
+        device.waitIdle();
+        if (scene.bCapture) {
+            result.nDropped = capture.nDropped - nDroppedWarmup;
+            capture.stop();
+            std::filesystem::remove(capturePath);
+        }
+
+        // gather memory stats while the scene's resources are still alive
+        vma::TotalStatistics stats = alloc->calculateStatistics();
+        result.allocationBytes = stats.total.statistics.allocationBytes;
+        result.blockBytes = stats.total.statistics.blockBytes;
+        result.cpu = Percentiles(cpuTimes);
+        result.gpu = Percentiles(gpuTimes);
+        return result;
+    }
+
+    // time until the scene's mesh batch (and texture) can be drawn, repeated nUploadRuns times
+    UploadRun upload(bool bDirect, const Options& options) {
+        UploadRun result = { .path = bDirect ? "direct" : "staging" };
+        vk::CommandPoolCreateInfo poolInfo = vk::CommandPoolCreateInfo()
+            .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+            .setQueueFamilyIndex(queues.graphics.index);
+        vk::raii::CommandPool commandPool = device.createCommandPool(poolInfo);
+        vk::CommandBufferAllocateInfo bufferInfo = vk::CommandBufferAllocateInfo()
+            .setCommandBufferCount(1)
+            .setCommandPool(*commandPool)
+            .setLevel(vk::CommandBufferLevel::ePrimary);
+        vk::raii::CommandBuffer cmd = std::move(device.allocateCommandBuffers(bufferInfo).front());
+        vk::raii::Fence fence = device.createFence({});
+        Pipelines::Graphics pipeline = Pipelines::Graphics("mesh.vert", "mesh.frag"); // only groups the draws
+
+        std::vector<float> cpuTimes, readyTimes;
+        MeshFile::Mapping meshFile;
+        if (!options.meshPath.empty()) meshFile.open(options.meshPath);
+        for (uint32_t i = 0; i < options.nUploadRuns; i++) {
+            auto start = std::chrono::steady_clock::now();
+            // a larger grid than the scene's, so the copies are not dominated by fixed costs
+            MeshBatch batch;
+            auto [cubeVertices, cubeIndices] = Meshes::cube();
+            uint32_t mesh = meshFile.pData != nullptr ? batch.add_mesh(meshFile) : batch.add_mesh(cubeVertices, cubeIndices);
+            if (mesh == UINT32_MAX) mesh = batch.add_mesh(cubeVertices, cubeIndices);
+            constexpr int32_t gridSize = 300;
+            for (int32_t x = 0; x < gridSize; x++) {
+                for (int32_t z = 0; z < gridSize; z++) {
+                    batch.add_object(pipeline, mesh, glm::translate(glm::mat4(1.0f), glm::vec3(x, 0, z) * 3.0f), glm::vec4(1.0f));
+                }
+            }
+            Texture texture;
+            texture.bDirect = bDirect;
+            bool bTexture = !options.texturePath.empty() && texture.load_ktx2(physDevice, device, alloc, options.texturePath);
+            batch.upload(physDevice, alloc, bDirect);
+            auto uploaded = std::chrono::steady_clock::now();
+
+            // record whatever the path left for the gpu and wait for it
+            cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+            batch.prepare(cmd, queues.graphics);
+            if (bTexture) texture.prepare(cmd, queues.graphics);
+            cmd.end();
+            vk::TimelineSemaphoreSubmitInfo timelineInfo({}, ++queues.graphics.timelineValue);
+            vk::SubmitInfo submitInfo = vk::SubmitInfo()
+                .setPNext(&timelineInfo)
+                .setSignalSemaphores(*queues.graphics.timeline)
+                .setCommandBuffers(*cmd);
+            queues.graphics.queue.submit(submitInfo, *fence);
+            while (vk::Result::eTimeout == device.waitForFences(*fence, true, UINT64_MAX)) {}
+            device.resetFences(*fence);
+            queues.graphics.collect();
+            auto end = std::chrono::steady_clock::now();
+
+            cpuTimes.push_back(std::chrono::duration<float, std::milli>(uploaded - start).count());
+            readyTimes.push_back(std::chrono::duration<float, std::milli>(end - start).count());
+            if (i == 0) result.allocationBytes = alloc->calculateStatistics().total.statistics.allocationBytes;
+        }
+        result.cpu = Percentiles(cpuTimes);
+        result.ready = Percentiles(readyTimes);
+        return result;
+    }
+
+    bool bUnified = false; // every device local memory type is host visible
+    bool bDirectUploads = false;
+    vk::raii::Context context;
+    vk::raii::Instance instance = nullptr;
+    vk::raii::DebugUtilsMessengerEXT debugMsg = nullptr;
+    vk::raii::PhysicalDevice physDevice = nullptr;
+    vk::raii::Device device = nullptr;
+    vma::UniqueAllocator alloc;
+    Queues queues;
+};
+
+static std::vector<std::string> split(std::string_view str, char delim) {
+    std::vector<std::string> parts;
+    std::stringstream stream = std::stringstream(std::string(str));
+    for (std::string part; std::getline(stream, part, delim);) parts.push_back(part);
+    return parts;
+}
+static Options parse_options(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        bool bValue = i + 1 < argc;
+        if (arg == "--software") options.bSoftware = true;
+        else if (arg == "--validation") options.bValidation = true;
+        else if (arg == "--scenes" && bValue) options.scenes = split(argv[++i], ',');
+        else if (arg == "--frames" && bValue) options.nFrames = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--warmup" && bValue) options.nWarmup = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--output" && bValue) options.outputPath = argv[++i];
+        else if (arg == "--baseline" && bValue) options.baselinePath = argv[++i];
+        else if (arg == "--threshold" && bValue) options.threshold = std::strtof(argv[++i], nullptr);
+        else if (arg == "--startup" && bValue) options.nStartupRuns = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--exe" && bValue) options.executable = argv[++i];
+        else if (arg == "--mesh" && bValue) options.meshPath = argv[++i];
+        else if (arg == "--texture" && bValue) options.texturePath = argv[++i];
+        else if (arg == "--upload" && bValue) options.uploadPath = argv[++i];
+        else if (arg == "--uploads" && bValue) options.nUploadRuns = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--audio" && bValue) options.nAudioVoices = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--audio-streams" && bValue) options.nAudioStreams = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--audio-period" && bValue) options.audioPeriod = std::max<uint32_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--res" && bValue) {
+            options.resolutions.clear();
+            for (const std::string& res : split(argv[++i], ',')) {
+                uint32_t width = 0, height = 0;
+                if (std::sscanf(res.c_str(), "%ux%u", &width, &height) == 2) options.resolutions.emplace_back(width, height);
+                else fmt::println("invalid resolution: {}", res);
+            }
+        }
+        else fmt::println("unknown argument: {}", arg);
+    }
+    return options;
+}
+
+// reads "<metric>": {"p50": <value> from a baseline line written by Run::to_json()
+static float read_p50(const std::string& line, std::string_view metric) {
+    std::string pattern = fmt::format("\"{}\": {{\"p50\": ", metric);
+    size_t pos = line.find(pattern);
+    if (pos == std::string::npos) return 0.0f;
+    return std::strtof(line.c_str() + pos + pattern.size(), nullptr);
+}
+static bool compare_baseline(const std::vector<Run>& runs, const Options& options) {
+    std::ifstream file(options.baselinePath);
+    if (!file) {
+        fmt::println("could not open baseline: {}", options.baselinePath);
+        return false;
+    }
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);) lines.push_back(line);
+
+    bool bRegression = false;
+    for (const Run& run : runs) {
+        std::string key = fmt::format("\"scene\": \"{}\", \"width\": {}, \"height\": {}", run.scene, run.extent.width, run.extent.height);
+        auto it = std::find_if(lines.begin(), lines.end(), [&](const std::string& line) { return line.find(key) != std::string::npos; });
+        if (it == lines.end()) {
+            fmt::println("{} {}x{}: no baseline", run.scene, run.extent.width, run.extent.height);
+            continue;
+        }
+        for (auto [metric, current] : { std::pair("cpu_ms", run.cpu.p50), std::pair("gpu_ms", run.gpu.p50) }) {
+            float baseline = read_p50(*it, metric);
+            if (baseline <= 0.0f || current <= 0.0f) continue;
+            float delta = current / baseline - 1.0f;
+            bool bSlower = delta > options.threshold;
+            bRegression |= bSlower;
+            fmt::println("{} {}x{} {} p50: {:.3f} -> {:.3f} ({:+.1f}%){}", run.scene, run.extent.width, run.extent.height,
+                metric, baseline, current, delta * 100.0f, bSlower ? " REGRESSION" : "");
+        }
+    }
+    return bRegression;
+}
+
+// launches the windowed renderer repeatedly, each run quitting after its first presented frame
+static int run_startup(const Options& options, const char* argv0) {
+    std::filesystem::path exe = options.executable;
+    if (exe.empty()) exe = std::filesystem::path(argv0).parent_path() / "vulkan-renderer";
+    std::filesystem::path reportPath = std::filesystem::temp_directory_path() / "vulkan-renderer-startup.json";
+
+    // gather samples per stage, keeping the order of the first report
+    std::vector<std::string> order;
+    std::map<std::string, std::vector<float>> samples;
+    for (uint32_t i = 0; i < options.nStartupRuns; i++) {
+        std::filesystem::remove(reportPath);
+        std::string command = fmt::format("\"{}\" --startup-report \"{}\" --quit-after-first-frame", exe.string(), reportPath.string());
+        if (std::system(command.c_str()) != 0) fmt::println("startup run {} exited with an error", i);
+        std::ifstream file(reportPath);
+        if (!file) {
+            fmt::println("startup run {} wrote no report", i);
+            continue;
+        }
+        // report lines are formatted as "key": value
+        for (std::string line; std::getline(file, line);) {
+            size_t keyStart = line.find('"');
+            size_t keyEnd = line.find("\": ", keyStart + 1);
+            if (keyStart == std::string::npos || keyEnd == std::string::npos || line.back() == '{') continue;
+            std::string key = line.substr(keyStart + 1, keyEnd - keyStart - 1);
+            if (!samples.contains(key)) order.push_back(key);
+            samples[key].push_back(std::strtof(line.c_str() + keyEnd + 3, nullptr));
+        }
+    }
+
+    // report distribution per stage
+    std::string json = "{\"startup\": {\n";
+    for (size_t i = 0; i < order.size(); i++) {
+        Percentiles stats(samples[order[i]]);
+        fmt::println("{:<16} p50 {:>8.2f} ms p90 {:>8.2f} ms max {:>8.2f} ms", order[i], stats.p50, stats.p90, stats.max);
+        json += fmt::format("  \"{}\": {}{}\n", order[i], stats.to_json(), i + 1 < order.size() ? "," : "");
+    }
+    json += "}}\n";
+    if (!options.outputPath.empty()) std::ofstream(options.outputPath) << json;
+    return 0;
+}
+
+// both upload paths on the same device, the direct path writes host visible memory wherever the allocator finds it
+static int run_uploads(Headless& headless, const Options& options) {
+    if (!headless.bUnified) fmt::println("device memory is not unified, direct uploads may land in system memory");
+    std::string json = "{\"uploads\": [\n";
+    for (bool bDirect : { false, true }) {
+        UploadRun run = headless.upload(bDirect, options);
+        fmt::println("{:<8} upload: cpu p50 {:.3f} ms | ready p50 {:.3f} ms p99 {:.3f} ms | {:.1f} MiB allocated",
+            run.path, run.cpu.p50, run.ready.p50, run.ready.p99, run.allocationBytes / (1024.0f * 1024.0f));
+        json += fmt::format("  {}{}\n", run.to_json(), bDirect ? "" : ",");
+    }
+    json += "]}\n";
+    if (!options.outputPath.empty()) std::ofstream(options.outputPath) << json;
+    return 0;
+}
+
+// half the voices play at the device rate and are mixed directly, the other half are resampled stereo
+static int run_audio(const Options& options) {
+    Audio::Mixer mixer;
+    std::vector<float> mono(48000), stereo(44100 * 2);
+    for (size_t i = 0; i < mono.size(); i++) mono[i] = std::sin((float)i * 0.0575f);
+    for (size_t i = 0; i < stereo.size() / 2; i++) stereo[i * 2] = stereo[i * 2 + 1] = std::sin((float)i * 0.0626f);
+    uint32_t direct = mixer.load(mono, 1, 48000);
+    uint32_t resampled = mixer.load(stereo, 2, 44100);
+    uint32_t nVoices = std::min(options.nAudioVoices, Audio::Mixer::maxVoices);
+    for (uint32_t i = 0; i < nVoices; i++) {
+        float pan = (float)i / nVoices * 2.0f - 1.0f;
+        if (i % 2 == 0) mixer.play(direct, 1.0f / nVoices, pan, 1.0f, true);
+        else mixer.play(resampled, 1.0f / nVoices, pan, 1.0f + 0.01f * i, true);
+    }
+
+    // mixing cost per period without a device
+    constexpr uint32_t nWarmup = 100, nPeriods = 5000;
+    std::vector<float> output(options.audioPeriod * 2);
+    std::vector<float> times;
+    float totalMs = 0.0f;
+    for (uint32_t i = 0; i < nWarmup + nPeriods; i++) {
+        auto start = std::chrono::steady_clock::now();
+        mixer.render(output.data(), options.audioPeriod);
+        float ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (i < nWarmup) continue;
+        times.push_back(ms);
+        totalMs += ms;
+    }
+    Percentiles period(times);
+    float periodMs = options.audioPeriod * 1000.0f / mixer.sampleRate;
+    float voicesPerMs = totalMs > 0.0f ? nVoices * nPeriods / totalMs : 0.0f; // voices of one period each
+    float realtimeVoices = period.p99 > 0.0f ? nVoices * periodMs / period.p99 : 0.0f; // at p99 cost within one period
+    fmt::println("audio: {} voices, {} frame periods ({:.2f} ms) | mix p50 {:.4f} ms p99 {:.4f} ms | {:.0f} voices/ms | ~{:.0f} voices in real time",
+        nVoices, options.audioPeriod, periodMs, period.p50, period.p99, voicesPerMs, realtimeVoices);
+
+    // the same mixer driven by a device thread on the null backend, with streams decoded alongside
+    // the stream source is a 16 bit 44.1 kHz wav, so decoding includes the conversion to the device rate
+    std::filesystem::path wavPath = std::filesystem::temp_directory_path() / "vulkan-renderer-stream.wav";
+    {
+        constexpr uint32_t rate = 44100, nFrames = rate * 10;
+        std::vector<int16_t> pcm(nFrames * 2);
+        for (uint32_t i = 0; i < nFrames; i++) pcm[i * 2] = pcm[i * 2 + 1] = (int16_t)(std::sin((float)i * 0.0626f) * 8000.0f);
+        auto u32 = [](uint32_t value) { return std::string(reinterpret_cast<const char*>(&value), 4); };
+        auto u16 = [](uint16_t value) { return std::string(reinterpret_cast<const char*>(&value), 2); };
+        uint32_t dataBytes = nFrames * 4;
+        std::string header = "RIFF" + u32(36 + dataBytes) + "WAVEfmt " + u32(16) + u16(1) + u16(2) + u32(rate) + u32(rate * 4) + u16(4) + u16(16) + "data" + u32(dataBytes);
+        std::ofstream file(wavPath, std::ios::binary);
+        file << header;
+        file.write(reinterpret_cast<const char*>(pcm.data()), dataBytes);
+    }
+    Audio::Config config = { .periodFrames = options.audioPeriod, .bNullBackend = true };
+    uint64_t nCallbacks = 0;
+    uint32_t nStreams = std::min(options.nAudioStreams, Audio::Mixer::maxVoices - nVoices);
+    uint32_t nUnderruns = 0;
+    uint32_t deviceRate = config.sampleRate;
+    if (mixer.init(config)) {
+        for (uint32_t i = 0; i < nStreams; i++) mixer.play_file(wavPath.string(), 1.0f / (nStreams + 1), 0.0f, true);
+        uint64_t before = mixer.nCallbacks.load();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        nCallbacks = mixer.nCallbacks.load() - before;
+        nUnderruns = mixer.nUnderruns.load();
+        deviceRate = mixer.sampleRate;
+        mixer.shutdown();
+    }
+    std::filesystem::remove(wavPath);
+    // streams buffer at the rate the device was opened with, which may differ from the requested one
+    float streamBytes = nStreams * std::bit_ceil(deviceRate * config.streamBufferMs / 1000 * 2) * sizeof(float);
+    fmt::println("null backend: {} callbacks in 1 s, {} streams with {} underruns, {:.1f} MiB stream buffers",
+        nCallbacks, nStreams, nUnderruns, streamBytes / (1024.0f * 1024.0f));
+
+    std::string json = fmt::format("{{\"audio\": {{\"voices\": {}, \"period_frames\": {}, \"period_ms\": {:.4f}, \"mix_ms\": {}, \"voices_per_ms\": {:.1f}, \"realtime_voices\": {:.1f}, \"null_callbacks\": {}, \"streams\": {}, \"stream_underruns\": {}}}}}\n",
+        nVoices, options.audioPeriod, periodMs, period.to_json(), voicesPerMs, realtimeVoices, nCallbacks, nStreams, nUnderruns);
+    if (!options.outputPath.empty()) std::ofstream(options.outputPath) << json;
+    return nCallbacks > 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    Options options = parse_options(argc, argv);
+    if (options.nStartupRuns > 0) return run_startup(options, argv[0]);
+    if (options.nAudioVoices > 0) return run_audio(options);
+    Headless headless(options);
+    if (options.nUploadRuns > 0) return run_uploads(headless, options);
+
+    // run all scene/resolution pairs
+    std::vector<Run> runs;
+    for (const std::string& sceneName : options.scenes) {
+        auto scene = std::find_if(scenes.begin(), scenes.end(), [&](const Scene& scene) { return scene.name == sceneName; });
+        if (scene == scenes.end()) {
+            fmt::println("unknown scene: {}", sceneName);
+            continue;
+        }
+        for (vk::Extent2D extent : options.resolutions) {
+            runs.push_back(headless.run(*scene, extent, options));
+            const Run& run = runs.back();
+            fmt::println("{} {}x{}: cpu p50 {:.3f} ms p99 {:.3f} ms | gpu p50 {:.3f} ms p99 {:.3f} ms",
+                run.scene, extent.width, extent.height, run.cpu.p50, run.cpu.p99, run.gpu.p50, run.gpu.p99);
+        }
+    }
+
+    // emit results, one run per line so they can be used as baseline later on
+    std::string json = "{\"runs\": [\n";
+    for (size_t i = 0; i < runs.size(); i++) json += fmt::format("  {}{}\n", runs[i].to_json(), i + 1 < runs.size() ? "," : "");
+    json += "]}\n";
+    if (options.outputPath.empty()) fmt::print("{}", json);
+    else std::ofstream(options.outputPath) << json;
+
+    // compare against stored baseline
+    if (options.baselinePath.empty()) return 0;
+    return compare_baseline(runs, options) ? 1 : 0;
+}
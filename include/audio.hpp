@@ -0,0 +1,185 @@
+#pragma once
+//
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+//
+#include "metrics.hpp"
+#include "spsc_queue.hpp"
+
+// forward declare
+struct ma_context;
+struct ma_device;
+struct ma_decoder;
+
+// real-time mixer for ui and alert sounds on top of miniaudio
+// the main thread sends commands through a lock-free queue, the device callback never locks or allocates
+// voices are resampled (pitch and source rate) with linear interpolation and mixed with sse/avx where the build enables it
+// files are memory mapped: short clips are decoded whole into a shared lru cache, long ones are streamed
+// through a bounded ring per voice that a worker thread keeps filled, so memory does not grow with their length
+namespace Audio {
+    struct Config {
+        uint32_t sampleRate = 48000;
+        uint32_t periodFrames = 256; // frames per callback, lower means less latency and less headroom
+        uint32_t nPeriods = 2;
+        bool bNullBackend = false; // silent device with a real callback thread, for headless runs and tests
+        uint32_t streamBufferMs = 250; // decoded audio buffered per stream
+        float clipSeconds = 4.0f; // files up to this length are cached as clips instead of streamed
+        size_t clipCacheBytes = 32 << 20;
+    };
+    // decoded samples in planar float at their source rate, right is empty for mono sounds
+    struct Sound {
+        std::vector<float> left;
+        std::vector<float> right;
+        uint32_t nFrames = 0;
+        uint32_t sampleRate = 0;
+        mutable std::atomic<uint32_t> nPlaying = 0; // voices using the samples, evicted clips are freed at 0
+    };
+    // planar copy of interleaved samples, padded for interpolation
+    void fill_sound(Sound& sound, std::span<const float> interleaved, uint32_t nChannels, uint32_t sampleRate);
+    // file decoded incrementally into a ring of interleaved stereo at the device rate
+    struct Stream {
+        Stream();
+        Stream(const Stream&) = delete;
+        Stream& operator=(const Stream&) = delete;
+        ~Stream();
+
+        // maps the file and prepares the decoder, nothing is decoded yet
+        bool open(std::string_view path, uint32_t sampleRate, uint32_t bufferFrames, bool bLoop);
+        // worker thread: decodes until the ring is full or the source ended
+        void fill(std::span<float> scratch);
+
+        SpscRing<float> ring;
+        std::atomic<bool> bDecoded = false; // source ended, whatever is left is in the ring
+        std::atomic<bool> bReleased = false; // no voice reads the ring anymore
+
+    private:
+        const std::byte* pData = nullptr;
+        size_t size = 0;
+        std::unique_ptr<ma_decoder> pDecoder;
+        bool bLoop = false;
+    };
+
+    struct Mixer {
+        static constexpr uint32_t maxVoices = 64;
+        static constexpr uint32_t blockFrames = 1024; // callbacks larger than this are mixed in several blocks
+
+        Mixer(); // defined with the miniaudio types
+        Mixer(const Mixer&) = delete;
+        Mixer& operator=(const Mixer&) = delete;
+        ~Mixer();
+
+        // opens and starts the playback device, without a device render() can still be called directly
+        bool init(const Config& config = {});
+        void shutdown();
+
+        // sounds stay loaded until the mixer is destroyed, returns UINT32_MAX on failure
+        uint32_t load(std::string_view path);
+        uint32_t load(std::span<const float> interleaved, uint32_t nChannels, uint32_t sampleRate);
+
+        // returns a voice handle, 0 if the command queue is full
+        // pan is -1 (left) to 1 (right), pitch scales the playback rate
+        uint32_t play(uint32_t sound, float gain = 1.0f, float pan = 0.0f, float pitch = 1.0f, bool bLoop = false);
+        // plays a file from the clip cache, or streams it if it is long or its length is unknown
+        uint32_t play_file(std::string_view path, float gain = 1.0f, float pan = 0.0f, bool bLoop = false);
+        // gain changes and stops are ramped over one period to avoid clicks
+        void set_gain(uint32_t voice, float gain, float pan = 0.0f);
+        void stop(uint32_t voice);
+        void stop_all();
+        void set_master(float gain);
+
+        // mixes nFrames of interleaved stereo into pOutput, called by the device thread
+        // or by the owner of a mixer without a running device
+        void render(float* pOutput, uint32_t nFrames);
+
+        uint32_t sampleRate = 48000; // of the opened device
+        uint32_t periodFrames = 0;
+        std::atomic<uint32_t> nActiveVoices = 0;
+        std::atomic<uint32_t> nStolenVoices = 0; // plays without a free voice, the oldest voice was replaced
+        std::atomic<uint64_t> nCallbacks = 0;
+        std::atomic<uint32_t> nUnderruns = 0; // blocks a stream could not fill completely
+
+    private:
+        struct Command {
+            enum class Type : uint32_t { ePlay, eGain, eStop, eStopAll, eMaster };
+            Type type = Type::ePlay;
+            uint32_t voice = 0;
+            const Sound* pSound = nullptr;
+            Stream* pStream = nullptr;
+            float gain = 1.0f, pan = 0.0f, pitch = 1.0f;
+            bool bLoop = false;
+        };
+        struct Voice {
+            bool active() const { return pSound != nullptr || pStream != nullptr; }
+            const Sound* pSound = nullptr;
+            Stream* pStream = nullptr;
+            uint32_t handle = 0;
+            uint64_t position = 0; // 32.32 fixed point source frame
+            uint64_t step = 0;
+            float gainLeft = 0.0f, gainRight = 0.0f; // at the start of the next block
+            float targetLeft = 0.0f, targetRight = 0.0f;
+            bool bLoop = false;
+            bool bStopping = false;
+        };
+        struct Clip {
+            std::string path;
+            std::unique_ptr<Sound> pSound;
+            size_t bytes;
+        };
+        uint32_t play(const Sound& sound, float gain, float pan, float pitch, bool bLoop);
+        uint32_t send_play(Command command); // assigns the voice handle, 0 if the queue is full
+        bool send(const Command& command);
+        void process_commands();
+        void mix_voice(Voice& voice, uint32_t nFrames);
+        void mix_stream(Voice& voice, uint32_t nFrames);
+        void set_target(Voice& voice, float gain, float pan);
+        void release(Voice& voice);
+        // decodes a whole mapped file into the cache, nullptr if it is too long or cannot be decoded
+        const Sound* load_clip(std::string_view path);
+        void work();
+
+        // main thread
+        Config config;
+        std::unique_ptr<ma_context> pContext;
+        std::unique_ptr<ma_device> pDevice;
+        std::deque<Sound> sounds; // stable addresses, voices point into it
+        uint32_t nextHandle = 1;
+        std::list<Clip> clips; // most recently used first
+        std::unordered_map<std::string, std::list<Clip>::iterator> clipLookup;
+        std::vector<std::unique_ptr<Sound>> evictedClips; // until their last voice finished
+        size_t clipBytes = 0;
+
+        // stream worker, the mutex guards the stream list between the main thread and the worker
+        std::vector<std::unique_ptr<Stream>> streams;
+        std::mutex streamMutex;
+        std::condition_variable streamCv;
+        std::thread worker;
+        bool bStopWorker = false;
+
+        // callback thread
+        SpscQueue<Command, 256> commands;
+        std::array<Voice, maxVoices> voices;
+        float masterGain = 1.0f, masterTarget = 1.0f;
+        alignas(32) std::array<float, blockFrames> mixLeft;
+        alignas(32) std::array<float, blockFrames> mixRight;
+        alignas(32) std::array<float, blockFrames> scratchLeft;
+        alignas(32) std::array<float, blockFrames> scratchRight;
+        alignas(32) std::array<float, blockFrames * 2> scratchStream;
+        Metrics::Histogram* pCallbackTime = &Metrics::histogram("audio_callback_ms");
+        Metrics::Gauge* pVoices = &Metrics::gauge("audio_voices");
+        Metrics::Counter* pUnderruns = &Metrics::counter("audio_stream_underruns");
+        Metrics::Gauge* pStreams = &Metrics::gauge("audio_streams");
+        Metrics::Gauge* pClipBytes = &Metrics::gauge("audio_clip_cache_bytes");
+    };
+}
@@ -0,0 +1,280 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.hpp>
+#include <glm/glm.hpp>
+#include <fmt/base.h>
+//
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cstring>
+#include <span>
+#include <utility>
+#include <vector>
+//
+#include "mesh_file.hpp"
+#include "vk_wrappers/buffer.hpp"
+#include "vk_wrappers/pipeline.hpp"
+#include "vk_wrappers/queues.hpp"
+
+// vertex layout of mesh.vert
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+// meshes share one vertex and index buffer, objects sharing a pipeline are drawn with a single indirect call
+struct MeshBatch {
+    struct Mesh {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        int32_t vertexOffset;
+        glm::vec4 sphere; // local bounding sphere (center, radius)
+    };
+    // per-object data, indexed by gl_InstanceIndex (firstInstance of its draw command)
+    struct Object {
+        glm::mat4 model;
+        glm::vec4 color;
+        glm::vec4 sphere; // world space bounding sphere (center, radius)
+    };
+    // per-draw location of the batch it belongs to, used to compact culled draws
+    struct DrawInfo {
+        uint32_t batch;
+        uint32_t firstDraw;
+    };
+    struct Batch {
+        Pipelines::Graphics* pPipeline;
+        std::vector<vk::DrawIndexedIndirectCommand> draws;
+        uint32_t firstDraw = 0; // offset into the shared indirect buffer
+    };
+
+    uint32_t add_mesh(std::span<const Vertex> meshVertices, std::span<const uint32_t> meshIndices) {
+        // bounding sphere around the center of the bounding box
+        glm::vec3 min = glm::vec3(FLT_MAX), max = glm::vec3(-FLT_MAX);
+        for (const Vertex& vertex : meshVertices) {
+            min = glm::min(min, vertex.position);
+            max = glm::max(max, vertex.position);
+        }
+        glm::vec3 center = (min + max) * 0.5f;
+        float radius = 0.0f;
+        for (const Vertex& vertex : meshVertices) radius = std::max(radius, glm::distance(center, vertex.position));
+
+        // keep a copy, the caller's data may be temporary
+        std::span<const std::byte> vertexCopy = ownedData.emplace_back(std::as_bytes(meshVertices).begin(), std::as_bytes(meshVertices).end());
+        std::span<const std::byte> indexCopy = ownedData.emplace_back(std::as_bytes(meshIndices).begin(), std::as_bytes(meshIndices).end());
+        return add_source(vertexCopy, indexCopy, 0, meshIndices.size(), glm::vec4(center, radius));
+    }
+    // references the mapped file until upload(), which copies it straight into staging memory
+    uint32_t add_mesh(const MeshFile::Mapping& file, uint32_t lod = 0) {
+        const MeshFile::Header& header = file.header();
+        if (header.vertexStride != sizeof(Vertex) || lod >= header.lodCount) {
+            fmt::println("mesh file has an incompatible vertex layout or no lod {}", lod);
+            return UINT32_MAX;
+        }
+        const MeshFile::Lod& range = file.lods()[lod];
+        glm::vec4 sphere = glm::vec4(header.sphere[0], header.sphere[1], header.sphere[2], header.sphere[3]);
+        return add_source(file.vertices(), std::as_bytes(file.indices()), range.firstIndex, range.indexCount, sphere);
+    }
+    void add_object(Pipelines::Graphics& pipeline, uint32_t mesh, const glm::mat4& model, glm::vec4 color) {
+        auto batch = std::find_if(batches.begin(), batches.end(), [&](const Batch& batch) { return batch.pPipeline == &pipeline; });
+        if (batch == batches.end()) batch = batches.insert(batches.end(), Batch{ &pipeline });
+        const Mesh& info = meshes[mesh];
+        batch->draws.emplace_back(info.indexCount, 1, info.firstIndex, info.vertexOffset, (uint32_t)objects.size());
+        // scale the radius by the largest axis scale of the model matrix
+        float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+        objects.emplace_back(model, color, glm::vec4(glm::vec3(model * glm::vec4(glm::vec3(info.sphere), 1.0f)), info.sphere.w * scale));
+    }
+    // create device buffers and fill a staging buffer, the copy is recorded by the next prepare()
+    // direct uploads write the device buffers in place instead, meant for unified memory devices
+    void upload(vk::raii::PhysicalDevice& physDevice, vma::UniqueAllocator& alloc, bool bDirect = false) {
+        vk::PhysicalDeviceFeatures features = physDevice.getFeatures();
+        auto [features2, features12] = physDevice.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+        bMultiDraw = features.multiDrawIndirect;
+        bDrawCount = bMultiDraw && features12.drawIndirectCount;
+
+        // lay out all draw commands contiguously, one count per batch
+        std::vector<vk::DrawIndexedIndirectCommand> draws;
+        std::vector<uint32_t> counts;
+        std::vector<DrawInfo> drawInfos;
+        for (uint32_t i = 0; i < batches.size(); i++) {
+            Batch& batch = batches[i];
+            batch.firstDraw = draws.size();
+            draws.insert(draws.end(), batch.draws.begin(), batch.draws.end());
+            drawInfos.insert(drawInfos.end(), batch.draws.size(), DrawInfo{ i, batch.firstDraw });
+            counts.push_back(batch.draws.size());
+        }
+        nDraws = draws.size();
+        if (draws.empty()) return;
+
+        vk::BufferUsageFlags dstUsage = bDirect ? vk::BufferUsageFlags() : vk::BufferUsageFlagBits::eTransferDst;
+        vma::AllocationCreateFlags hostFlags = bDirect ? vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped : vma::AllocationCreateFlags();
+        vertexBuffer = Buffer(alloc, (vk::DeviceSize)nVertices * sizeof(Vertex), dstUsage | vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer, hostFlags);
+        indexBuffer = Buffer(alloc, (vk::DeviceSize)nIndices * sizeof(uint32_t), dstUsage | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eStorageBuffer, hostFlags);
+        objectBuffer = Buffer(alloc, std::span(objects).size_bytes(), dstUsage | vk::BufferUsageFlagBits::eStorageBuffer, hostFlags);
+        drawBuffer = Buffer(alloc, std::span(draws).size_bytes(), dstUsage | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer, hostFlags);
+        countBuffer = Buffer(alloc, std::span(counts).size_bytes(), dstUsage | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer, hostFlags);
+        drawInfoBuffer = Buffer(alloc, std::span(drawInfos).size_bytes(), dstUsage | vk::BufferUsageFlagBits::eStorageBuffer, hostFlags);
+        // written by gpu culling, the count is cleared with a transfer every frame
+        visibleBuffer = Buffer(alloc, drawBuffer.size, vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+        visibleCountBuffer = Buffer(alloc, countBuffer.size, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+
+        // sources of every uploaded buffer, in the order prepare() copies them
+        std::array<std::pair<Buffer*, std::vector<std::span<const std::byte>>>, 6> uploads = {{
+            { &vertexBuffer, vertexSources }, { &indexBuffer, indexSources },
+            { &objectBuffer, { std::as_bytes(std::span(objects)) } }, { &drawBuffer, { std::as_bytes(std::span(draws)) } },
+            { &countBuffer, { std::as_bytes(std::span(counts)) } }, { &drawInfoBuffer, { std::as_bytes(std::span(drawInfos)) } },
+        }};
+        if (bDirect) {
+            for (auto& [pBuffer, sources] : uploads) {
+                vk::DeviceSize offset = 0;
+                for (const auto& source : sources) {
+                    std::memcpy(static_cast<std::byte*>(pBuffer->pMapped) + offset, source.data(), source.size());
+                    offset += source.size();
+                }
+                alloc->flushAllocation(*pBuffer->allocation, 0, vk::WholeSize);
+            }
+        }
+        else {
+            // pack everything into one staging buffer, in the order of the device buffers
+            vk::DeviceSize stagingSize = 0;
+            for (const auto& [pBuffer, sources] : uploads) stagingSize += pBuffer->size;
+            staging = Buffer(alloc, stagingSize, vk::BufferUsageFlagBits::eTransferSrc,
+                vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped);
+            vk::DeviceSize offset = 0;
+            for (const auto& [pBuffer, sources] : uploads) {
+                for (const auto& source : sources) {
+                    std::memcpy(static_cast<std::byte*>(staging.pMapped) + offset, source.data(), source.size());
+                    offset += source.size();
+                }
+            }
+            alloc->flushAllocation(*staging.allocation, 0, vk::WholeSize);
+            bUploadPending = true;
+        }
+
+        // sources are no longer referenced, mapped files may be closed
+        vertexSources.clear();
+        indexSources.clear();
+        ownedData.clear();
+    }
+    // call outside of rendering, before draw(), staging memory is retired into the queue the copy is submitted to
+    void prepare(vk::raii::CommandBuffer& cmd, Queue& queue) {
+        if (!bUploadPending) return;
+        bUploadPending = false;
+
+        vk::DeviceSize offset = 0;
+        for (Buffer* pBuffer : { &vertexBuffer, &indexBuffer, &objectBuffer, &drawBuffer, &countBuffer, &drawInfoBuffer }) {
+            cmd.copyBuffer(*staging.buffer, *pBuffer->buffer, vk::BufferCopy(offset, 0, pBuffer->size));
+            offset += pBuffer->size;
+        }
+        vk::MemoryBarrier2 memBarrier = vk::MemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexInput | vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead);
+        cmd.pipelineBarrier2(vk::DependencyInfo().setMemoryBarriers(memBarrier));
+        queue.retire(std::move(staging));
+    }
+    // call inside of rendering, one indirect draw per pipeline
+    // culled draws come from visibleBuffer, compacted if drawIndirectCount is available, else with zeroed instance counts
+    void draw(vk::raii::CommandBuffer& cmd, BindState& state, vk::Extent2D extent, bool bCulled) {
+        vk::Buffer draws = bCulled ? *visibleBuffer.buffer : *drawBuffer.buffer;
+        vk::Buffer counts = bCulled ? *visibleCountBuffer.buffer : *countBuffer.buffer;
+        if (batches.empty() || vertexBuffer.size == 0) return;
+        cmd.bindVertexBuffers(0, *vertexBuffer.buffer, vk::DeviceSize(0));
+        cmd.bindIndexBuffer(*indexBuffer.buffer, 0, vk::IndexType::eUint32);
+
+        constexpr uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+        for (uint32_t i = 0; i < batches.size(); i++) {
+            Batch& batch = batches[i];
+            batch.pPipeline->bind(cmd, state, extent);
+            vk::DeviceSize drawOffset = batch.firstDraw * stride;
+            if (bDrawCount) {
+                cmd.drawIndexedIndirectCount(draws, drawOffset, counts, i * sizeof(uint32_t), batch.draws.size(), stride);
+            }
+            else if (bMultiDraw) {
+                cmd.drawIndexedIndirect(draws, drawOffset, batch.draws.size(), stride);
+            }
+            else {
+                // without multiDrawIndirect only a single command may be consumed per call
+                for (uint32_t draw = 0; draw < batch.draws.size(); draw++) {
+                    cmd.drawIndexedIndirect(draws, drawOffset + draw * stride, 1, stride);
+                }
+            }
+        }
+    }
+
+    std::vector<Mesh> meshes;
+    std::vector<Batch> batches;
+    Buffer objectBuffer; // bound by the pipelines' shaders
+    Buffer drawBuffer;
+    Buffer countBuffer;
+    Buffer drawInfoBuffer;
+    Buffer visibleBuffer;
+    Buffer visibleCountBuffer;
+    uint32_t nDraws = 0;
+    bool bDrawCount = false; // draws can be compacted, with their count read from a buffer
+
+private:
+    uint32_t add_source(std::span<const std::byte> vertexData, std::span<const std::byte> indexData, uint32_t firstIndex, uint32_t indexCount, glm::vec4 sphere) {
+        meshes.emplace_back(nIndices + firstIndex, indexCount, (int32_t)nVertices, sphere);
+        vertexSources.push_back(vertexData);
+        indexSources.push_back(indexData);
+        nVertices += vertexData.size() / sizeof(Vertex);
+        nIndices += indexData.size() / sizeof(uint32_t);
+        return meshes.size() - 1;
+    }
+
+    // vertex and index data of all meshes, only referenced until upload()
+    std::vector<std::span<const std::byte>> vertexSources;
+    std::vector<std::span<const std::byte>> indexSources;
+    std::vector<std::vector<std::byte>> ownedData;
+    uint32_t nVertices = 0;
+    uint32_t nIndices = 0;
+    std::vector<Object> objects;
+    Buffer vertexBuffer;
+    Buffer indexBuffer;
+    Buffer staging;
+    bool bUploadPending = false;
+    bool bMultiDraw = false;
+};
+
+// simple flat shaded shapes centered at the origin with unit extent
+namespace Meshes {
+    using Data = std::pair<std::vector<Vertex>, std::vector<uint32_t>>;
+    inline Data cube() {
+        Data data;
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            for (float sign : { -1.0f, 1.0f }) {
+                // face normal and two tangents, ordered for counter-clockwise winding
+                glm::vec3 normal = glm::vec3(0.0f);
+                normal[axis] = sign;
+                glm::vec3 u = glm::vec3(0.0f), v = glm::vec3(0.0f);
+                u[(axis + 1) % 3] = 0.5f;
+                v[(axis + 2) % 3] = 0.5f * sign;
+                uint32_t base = data.first.size();
+                for (glm::vec2 corner : { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) }) {
+                    data.first.emplace_back(normal * 0.5f + u * corner.x + v * corner.y, normal);
+                }
+                data.second.insert(data.second.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+            }
+        }
+        return data;
+    }
+    inline Data octahedron() {
+        Data data;
+        for (float x : { -0.5f, 0.5f }) {
+            for (float y : { -0.5f, 0.5f }) {
+                for (float z : { -0.5f, 0.5f }) {
+                    std::array<glm::vec3, 3> corners = { glm::vec3(x, 0, 0), glm::vec3(0, y, 0), glm::vec3(0, 0, z) };
+                    // flip winding for faces in octants with an odd number of negative axes
+                    if (x * y * z < 0.0f) std::swap(corners[1], corners[2]);
+                    glm::vec3 normal = glm::normalize(glm::vec3(x, y, z));
+                    uint32_t base = data.first.size();
+                    for (const glm::vec3& corner : corners) data.first.emplace_back(corner, normal);
+                    data.second.insert(data.second.end(), { base, base + 1, base + 2 });
+                }
+            }
+        }
+        return data;
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.hpp>
+//
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+//
+#include "vk_wrappers/buffer.hpp"
+#include "vk_wrappers/image.hpp"
+#include "vk_wrappers/queues.hpp"
+#include "vk_wrappers/tasks.hpp"
+
+// asynchronous readback of rendered frames into a ring of mapped buffers
+// every copy is a task awaiting the queue timeline value of its frame's submission, so recording never waits for the gpu
+// frames are encoded on a worker thread: a png sequence (path_00000.png, ...) or a single y4m stream if the path ends in .y4m
+// frames without a free ring slot are dropped instead of stalling the render loop
+// usage: F12 screenshot, F9 toggles capture.y4m, vulkan-renderer --replay session.input --headless --uncapped --capture session.y4m
+struct Capture {
+    Capture() = default;
+    Capture(const Capture&) = delete;
+    Capture& operator=(const Capture&) = delete;
+    ~Capture() { stop(); }
+
+    // nFrames == 0 captures until stop(), readbacks are spawned on the scheduler polled by the render loop
+    bool start(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc, Tasks::Scheduler& tasks,
+        const Image& image, std::string_view path, uint32_t nFrames = 0, uint32_t fps = 60);
+    // waits for pending copies through the scheduler and encodes them, call before the scheduler is cleared
+    void stop();
+    bool active() const { return bActive; }
+    // all requested frames were encoded, stop() will not wait
+    bool done() {
+        std::lock_guard lock(mutex);
+        return nFramesRequested > 0 && nRecorded >= nFramesRequested && std::ranges::all_of(slots, [](const Slot& slot) { return slot.state == SlotState::eFree; });
+    }
+
+    // copies the image into a free slot and returns it to eGeneral, call at the end of a frame's command buffer
+    // the command buffer has to be the next submission to the queue
+    void record(vk::raii::CommandBuffer& cmd, Image& image, Queue& queue);
+
+    uint32_t nCaptured = 0; // frames handed to the encoder
+    uint32_t nDropped = 0; // frames skipped because every slot was busy
+
+private:
+    enum class SlotState { eFree, eCopying, eEncoding };
+    struct Slot {
+        Buffer buffer;
+        uint32_t frame = 0;
+        SlotState state = SlotState::eFree;
+    };
+    static constexpr uint32_t nSlots = 4;
+
+    Tasks::Task readback(Queue& queue, uint64_t value, Slot& slot); // hands the copy to the worker once it finished
+    void work();
+    void encode(Slot& slot);
+    void write_png(uint32_t frame);
+    void write_y4m();
+
+    vk::raii::Device* pDevice = nullptr;
+    vma::UniqueAllocator* pAlloc = nullptr;
+    Tasks::Scheduler* pTasks = nullptr;
+    uint32_t nCopying = 0; // readbacks still awaiting their frame
+    Image converted; // rgba8 copy of the captured image, blitted on the gpu when supported
+    bool bConvertOnGpu = false;
+    vk::Extent2D extent;
+    vk::Format sourceFormat = vk::Format::eUndefined;
+    std::array<Slot, nSlots> slots;
+    uint32_t nFramesRequested = 0;
+    uint32_t nRecorded = 0;
+    bool bActive = false;
+
+    // encoder state, slots in eEncoding belong to the worker
+    std::string path;
+    bool bY4m = false;
+    uint32_t fps = 60;
+    std::ofstream stream;
+    std::vector<uint8_t> rgb, encoded; // worker scratch memory, reused between frames
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<uint32_t> jobs;
+    bool bStopping = false;
+};
@@ -0,0 +1,177 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.hpp>
+#include <glm/glm.hpp>
+//
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <vector>
+//
+#include "batch.hpp"
+#include "vk_wrappers/buffer.hpp"
+#include "vk_wrappers/image.hpp"
+#include "vk_wrappers/pipeline.hpp"
+#include "vk_wrappers/sampler.hpp"
+
+// gpu-driven visibility: draws of a mesh batch are culled against the frustum and the previous frame's depth pyramid
+struct Culling {
+    // must match cull.comp
+    struct Params {
+        glm::mat4 view;
+        std::array<glm::vec4, 6> planes;
+        float P00, P11;
+        float zNear, zFar;
+        glm::vec2 pyramidSize;
+        uint32_t drawCount;
+        uint32_t bCompact;
+    };
+
+    void reflect() {
+        cullPipe.reflect();
+        reducePipe.reflect();
+    }
+    void init(vk::raii::Device& device, vma::UniqueAllocator& alloc, SamplerCache& samplers, MeshBatch& batch, Image& depth,
+            const glm::mat4& view, const glm::mat4& proj, float zNear, float zFar) {
+        vk::SamplerCreateInfo samplerInfo = vk::SamplerCreateInfo()
+            .setMagFilter(vk::Filter::eNearest)
+            .setMinFilter(vk::Filter::eNearest)
+            .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+            .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+            .setMaxLod(vk::LodClampNone);
+        sampler = samplers.get(device, samplerInfo);
+        nDraws = batch.nDraws;
+
+        // one reduction instance per pyramid level, reading the level below (or the depth buffer)
+        create_pyramid(device, alloc, depth);
+        reducePipe.init(device, pyramidViews.size());
+        cullPipe.init(device);
+        write_params(alloc, batch, view, proj, zNear, zFar);
+        write_descriptors(batch, depth);
+    }
+    // replaces the pyramid and parameters after the depth buffer was resized, pipelines are kept
+    // the old ones and the descriptor pools in-flight frames still bind are retired on the queue
+    void resize(vk::raii::Device& device, vma::UniqueAllocator& alloc, Queue& queue, MeshBatch& batch, Image& depth,
+            const glm::mat4& view, const glm::mat4& proj, float zNear, float zFar) {
+        queue.retire(std::move(pyramidViews));
+        queue.retire(std::move(pyramid));
+        queue.retire(std::move(params));
+        create_pyramid(device, alloc, depth);
+        queue.retire(reducePipe.cs.reallocate(device, pyramidViews.size()));
+        queue.retire(cullPipe.cs.reallocate(device));
+        write_params(alloc, batch, view, proj, zNear, zFar);
+        write_descriptors(batch, depth);
+    }
+    // call before rendering, fills the batch's visible draw and count buffers
+    void execute(vk::raii::CommandBuffer& cmd, BindState& state, MeshBatch& batch) {
+        if (nDraws == 0) return;
+        // previous frame's indirect reads and pyramid writes have to finish first
+        barrier(cmd, vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eComputeShader,
+            vk::PipelineStageFlagBits2::eClear | vk::PipelineStageFlagBits2::eComputeShader);
+        if (pyramid.lastKnownLayout != vk::ImageLayout::eGeneral) {
+            // nothing is occluded until the first pyramid was built
+            pyramid.transition_layout_r_to_w(cmd, vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits2::eAllCommands, vk::PipelineStageFlagBits2::eClear);
+            cmd.clearColorImage(*pyramid.image, vk::ImageLayout::eGeneral, vk::ClearColorValue(1.0f, 1.0f, 1.0f, 1.0f),
+                vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, vk::RemainingMipLevels, 0, 1));
+        }
+        cmd.fillBuffer(*batch.visibleCountBuffer.buffer, 0, vk::WholeSize, 0);
+        barrier(cmd, vk::PipelineStageFlagBits2::eClear, vk::PipelineStageFlagBits2::eComputeShader);
+
+        cullPipe.execute(cmd, state, (nDraws + 63) / 64, 1, 1);
+        barrier(cmd, vk::PipelineStageFlagBits2::eComputeShader, vk::PipelineStageFlagBits2::eDrawIndirect);
+    }
+    // call after rendering, reduces the depth buffer into the pyramid used by the next frame
+    void build_pyramid(vk::raii::CommandBuffer& cmd, BindState& state, Image& depth) {
+        if (nDraws == 0) return;
+        depth.transition_layout_w_to_r(cmd, vk::ImageLayout::eReadOnlyOptimal,
+            vk::PipelineStageFlagBits2::eLateFragmentTests, vk::PipelineStageFlagBits2::eComputeShader);
+        for (uint32_t level = 0; level < pyramidViews.size(); level++) {
+            uint32_t width = std::max(pyramid.extent.width >> level, 1u);
+            uint32_t height = std::max(pyramid.extent.height >> level, 1u);
+            reducePipe.execute(cmd, state, (width + 15) / 16, (height + 15) / 16, 1, level);
+            barrier(cmd, vk::PipelineStageFlagBits2::eComputeShader, vk::PipelineStageFlagBits2::eComputeShader);
+        }
+    }
+
+private:
+    void create_pyramid(vk::raii::Device& device, vma::UniqueAllocator& alloc, Image& depth) {
+        // depth pyramid with power of two extents, so every texel of a level covers exactly 2x2 texels of the level below
+        vk::Extent3D pyramidExtent = vk::Extent3D(std::bit_floor(depth.extent.width), std::bit_floor(depth.extent.height), 1);
+        uint32_t nLevels = std::bit_width(std::max(pyramidExtent.width, pyramidExtent.height));
+        pyramid = Image(device, alloc, pyramidExtent, vk::Format::eR32Sfloat,
+            vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+            vk::ImageAspectFlagBits::eColor, nLevels);
+        pyramidViews.clear();
+        for (uint32_t level = 0; level < nLevels; level++) {
+            vk::ImageViewCreateInfo viewInfo = vk::ImageViewCreateInfo()
+                .setViewType(vk::ImageViewType::e2D)
+                .setImage(*pyramid.image).setFormat(pyramid.format)
+                .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level, 1, 0, 1));
+            pyramidViews.push_back(device.createImageView(viewInfo));
+        }
+    }
+    // static camera, so parameters are only written on init and resize
+    void write_params(vma::UniqueAllocator& alloc, MeshBatch& batch, const glm::mat4& view, const glm::mat4& proj, float zNear, float zFar) {
+        Params paramData = {
+            .view = view,
+            .planes = frustum_planes(proj * view),
+            .P00 = proj[0][0], .P11 = std::abs(proj[1][1]),
+            .zNear = zNear, .zFar = zFar,
+            .pyramidSize = glm::vec2(pyramid.extent.width, pyramid.extent.height),
+            .drawCount = batch.nDraws,
+            .bCompact = batch.bDrawCount,
+        };
+        params = Buffer(alloc, sizeof(Params), vk::BufferUsageFlagBits::eStorageBuffer,
+            vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped);
+        std::memcpy(params.pMapped, &paramData, sizeof(Params));
+        alloc->flushAllocation(*params.allocation, 0, vk::WholeSize);
+    }
+    void write_descriptors(MeshBatch& batch, Image& depth) {
+        for (uint32_t level = 0; level < pyramidViews.size(); level++) {
+            if (level == 0) reducePipe.cs.write_descriptor(*depth.view, sampler, 0, 0, level);
+            else reducePipe.cs.write_descriptor(*pyramidViews[level - 1], sampler, 0, 0, level, vk::ImageLayout::eGeneral);
+            reducePipe.cs.write_descriptor(*pyramidViews[level], 0, 1, level);
+        }
+        if (nDraws == 0) return;
+        cullPipe.cs.write_descriptor(params, 0, 0);
+        cullPipe.cs.write_descriptor(batch.objectBuffer, 0, 1);
+        cullPipe.cs.write_descriptor(batch.drawBuffer, 0, 2);
+        cullPipe.cs.write_descriptor(batch.drawInfoBuffer, 0, 3);
+        cullPipe.cs.write_descriptor(batch.visibleBuffer, 0, 4);
+        cullPipe.cs.write_descriptor(batch.visibleCountBuffer, 0, 5);
+        cullPipe.cs.write_descriptor(*pyramid.view, sampler, 0, 6, 0, vk::ImageLayout::eGeneral);
+    }
+    // Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix. Gribb & Hartmann, 2001
+    static std::array<glm::vec4, 6> frustum_planes(const glm::mat4& viewProj) {
+        glm::mat4 rows = glm::transpose(viewProj);
+        std::array<glm::vec4, 6> planes = {
+            rows[3] + rows[0], rows[3] - rows[0],
+            rows[3] + rows[1], rows[3] - rows[1],
+            rows[2], rows[3] - rows[2], // [0, 1] depth range
+        };
+        for (glm::vec4& plane : planes) plane /= glm::length(glm::vec3(plane));
+        return planes;
+    }
+    void barrier(vk::raii::CommandBuffer& cmd, vk::PipelineStageFlags2 srcStage, vk::PipelineStageFlags2 dstStage) {
+        vk::MemoryBarrier2 memBarrier = vk::MemoryBarrier2()
+            .setSrcStageMask(srcStage)
+            .setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite)
+            .setDstStageMask(dstStage)
+            .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite);
+        vk::DependencyInfo depInfo = vk::DependencyInfo()
+            .setMemoryBarriers(memBarrier);
+        cmd.pipelineBarrier2(depInfo);
+    }
+
+    Pipelines::Compute cullPipe = Pipelines::Compute("cull.comp");
+    Pipelines::Compute reducePipe = Pipelines::Compute("depth_reduce.comp");
+    Image pyramid;
+    std::vector<vk::raii::ImageView> pyramidViews;
+    vk::Sampler sampler; // owned by the renderer's sampler cache
+    Buffer params;
+    uint32_t nDraws = 0;
+};
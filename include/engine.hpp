@@ -3,42 +3,111 @@
 #include <vk_mem_alloc.hpp>
 #include <SDL3/SDL_events.h>
 #include <fmt/base.h>
+#include <fmt/chrono.h>
 #include <imgui.h>
 //
+#include <array>
 #include <chrono>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 //
 #include "SDL_keycode.h"
+#include "audio.hpp"
+#include "capture.hpp"
 #include "input.hpp"
+#include "metrics.hpp"
+#include "startup.hpp"
 #include "window.hpp"
 #include "renderer.hpp"
+#include "replay.hpp"
 #include "vk_wrappers/imgui_impl.hpp"
 #include "vk_wrappers/swapchain.hpp"
 #include "vk_wrappers/queues.hpp"
+#include "vk_wrappers/tasks.hpp"
 
 struct Engine {
-    Engine();
+    // headless engines render without presenting into a hidden window, meant for input replays
+    Engine(std::string_view meshPath = {}, std::string_view texturePath = {}, bool bHeadless = false);
     void run() {
         bRunning = true;
         bRendering = true;
+        if (!recordPath.empty()) recorder.open(recordPath, window.size().width, window.size().height);
+        if (!replayPath.empty() && player.open(replayPath) && window.size() != vk::Extent2D(player.header.width, player.header.height)) {
+            fmt::println("replay was recorded at {}x{}, mouse positions may not match", player.header.width, player.header.height);
+        }
+        if (!capturePath.empty()) renderer.start_capture(capture, physDevice, device, alloc, tasks, capturePath);
+        if (bMetrics) Metrics::start_publishing();
+        // the mixer runs on its own device thread, headless runs keep the callback on a silent device
+        audioConfig.bNullBackend |= bHeadless;
+        audio.init(audioConfig);
+        Replay::Clock::time_point replayStart = Replay::Clock::now();
+        std::vector<SDL_Event> replayEvents;
         while(bRunning) {
             Input::flush();
+            if (player.is_open()) {
+                // recorded events of this frame, paced like the recording unless uncapped
+                if (!player.next_frame(replayEvents, SDL_GetWindowID(window.pWindow))) break;
+                if (!bUncapped) std::this_thread::sleep_until(replayStart + player.frameTime);
+                for (SDL_Event& event : replayEvents) handle_event(event);
+            }
             SDL_Event event;
-            while (SDL_PollEvent(&event)) handle_event(event);
+            while (SDL_PollEvent(&event)) {
+                // live input is ignored while replaying, window events still apply
+                if (player.is_open() && Replay::payload_size(event.type) != 0 && event.type != SDL_EventType::SDL_EVENT_QUIT) continue;
+                recorder.event(event);
+                handle_event(event);
+            }
             handle_input();
+            tasks.poll();
 
             if (bRendering) {
-                ImGui::backend::new_frame();
-                ImGui::frontend::display_fps();
-                renderer.render(device, swapchain, queues);
+                bool bUiUpdate = player.is_open() ? ImGui::backend::new_frame(player.bUiUpdate) : ImGui::backend::new_frame();
+                if (bUiUpdate) {
+                    ImGui::frontend::display_fps();
+                    ImGui::frontend::display_postprocess(renderer.postProcess);
+                }
+                if (bHeadless) {
+                    ImGui::backend::render();
+                    renderer.render(device, queues);
+                }
+                else renderer.render(device, swapchain, queues);
+                if (player.is_open()) timings.frame(renderer.gpuTime);
+                update_metrics();
+                if (capture.active() && capture.done()) capture.stop();
+                if (!startup.bFirstFrame) {
+                    startup.first_frame();
+                    if (bQuitAfterFirstFrame) bRunning = false;
+                }
                 if (swapchain.bResizeRequested) handle_rebuild();
+                // only rendered frames are recorded, events of minimized iterations go into the next one
+                recorder.frame(bUiUpdate);
             }
             else std::this_thread::sleep_for(std::chrono::milliseconds(100));
         }
         device.waitIdle();
+        // pending readbacks are tasks, they are encoded before the scheduler drops the rest
+        capture.stop();
+        tasks.clear();
+        audio.shutdown();
+        Metrics::stop_publishing();
+        recorder.close();
+        if (!replayPath.empty()) timings.report(timingsPath);
         ImGui::backend::shutdown();
     }
 
+    StartupTimer startup; // created first to include member initialization
+    bool bQuitAfterFirstFrame = false;
+    std::string recordPath; // input log written while running
+    std::string replayPath; // input log replayed instead of live input
+    std::string timingsPath; // per-frame csv of a replay
+    std::string capturePath; // frames captured from the start, a png sequence or a .y4m video
+    bool bUncapped = false; // replay as fast as possible instead of at the recorded pace
+    bool bMetrics = false; // publish live metrics to shared memory, read with vulkan-renderer-metrics
+    Audio::Config audioConfig;
+    Audio::Mixer audio; // ui and alert sounds, safe to call from the main loop
+
 private:
     void handle_event(SDL_Event& event) {
         ImGui::backend::process_event(&event);
@@ -60,19 +129,56 @@ private:
     }
     void handle_rebuild() {
         SDL_SyncWindow(window.pWindow);
-        device.waitIdle();
-        if (window.size() != swapchain.extent) {
-            renderer = {};
-            renderer.init(device, alloc, queues, window.size());
-            swapchain = {};
-            swapchain.init(physDevice, device, window, queues);
-        }
+        if (window.size() == swapchain.extent) return;
+        // captures have a fixed resolution
+        capture.stop();
+
+        // extent dependent renderer resources are replaced, the old ones destroyed once the gpu is done with their last frame
+        renderer.resize(device, alloc, queues, window.size());
+        // the old swapchain is retired by the new one after its first present, its present semaphores may still be pending
+        auto pOldSwapchain = std::make_unique<Swapchain>(std::move(swapchain));
+        swapchain = {};
+        swapchain.init(physDevice, device, alloc, window, queues, std::move(pOldSwapchain));
     }
     void handle_input() {
         if (Keys::pressed(SDLK_F11)) window.toggle_fullscreen();
         if (Keys::down(SDLK_LALT) && Keys::pressed(SDLK_RETURN)) window.toggle_fullscreen();
         if (Keys::down(SDLK_LGUI) && Keys::down(SDLK_LSHIFT) && Keys::pressed(SDLK_UP)) window.toggle_fullscreen();
         if (Keys::down(SDLK_LALT) && Keys::pressed(SDLK_F4)) bRunning = false;
+        // captures are read back by tasks on the scheduler and encoded on a worker thread
+        if (Keys::pressed(SDLK_F12) && !capture.active()) {
+            auto time = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+            renderer.start_capture(capture, physDevice, device, alloc, tasks, fmt::format("screenshot_{:%Y%m%d_%H%M%S}.png", time), 1);
+        }
+        if (Keys::pressed(SDLK_F9)) {
+            if (capture.active()) capture.stop();
+            else renderer.start_capture(capture, physDevice, device, alloc, tasks, "capture.y4m");
+        }
+    }
+    // frame time, gpu time and allocator usage, the submit and wait metrics are recorded where they happen
+    void update_metrics() {
+        static Metrics::Histogram& frameTime = Metrics::histogram("frame_ms");
+        static Metrics::Gauge& gpuTime = Metrics::gauge("gpu_ms");
+        static Metrics::Gauge& vmaUsage = Metrics::gauge("vma_usage_bytes");
+        static Metrics::Gauge& vmaBudget = Metrics::gauge("vma_budget_bytes");
+        static Metrics::Gauge& vmaAllocated = Metrics::gauge("vma_allocation_bytes");
+        auto now = std::chrono::steady_clock::now();
+        if (lastFrame != std::chrono::steady_clock::time_point()) frameTime.record(std::chrono::duration<double, std::milli>(now - lastFrame).count());
+        lastFrame = now;
+        gpuTime.set(renderer.gpuTime);
+        // budgets are cached by vma and cheap to query every frame
+        std::array<vma::Budget, VK_MAX_MEMORY_HEAPS> budgets;
+        alloc->getHeapBudgets(budgets.data());
+        static uint32_t nHeaps = physDevice.getMemoryProperties().memoryHeapCount;
+        double usage = 0.0, budget = 0.0, allocated = 0.0;
+        for (uint32_t i = 0; i < nHeaps; i++) {
+            usage += (double)budgets[i].usage;
+            budget += (double)budgets[i].budget;
+            allocated += (double)budgets[i].statistics.allocationBytes;
+        }
+        vmaUsage.set(usage);
+        vmaBudget.set(budget);
+        vmaAllocated.set(allocated);
     }
 
 private:
@@ -85,7 +191,14 @@ private:
     Swapchain swapchain;
     Queues queues;
     Renderer renderer;
+    Capture capture;
+    Tasks::Scheduler tasks; // gpu workflows resumed once per loop, destroyed before the resources they use
+    Replay::Recorder recorder;
+    Replay::Player player;
+    Replay::Timings timings;
 
     bool bRunning;
     bool bRendering;
+    bool bHeadless = false;
+    std::chrono::steady_clock::time_point lastFrame;
 };
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// gpu-ready binary mesh container, written by vulkan-renderer-meshconv
+// layout: Header | Lod[lodCount] | Meshlet[meshletCount] | vertices | indices, each block aligned to blockAlignment
+namespace MeshFile {
+    constexpr uint32_t magic = 0x4853454d; // "MESH"
+    constexpr uint32_t version = 1;
+    constexpr uint64_t blockAlignment = 256;
+
+    struct Block {
+        uint64_t offset; // from the start of the file
+        uint64_t size; // in bytes
+    };
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertexStride; // position (vec3) followed by normal (vec3)
+        uint32_t vertexCount;
+        uint32_t indexCount; // uint32 indices of all lods, relative to the first vertex
+        uint32_t lodCount;
+        uint32_t meshletCount;
+        uint32_t reserved;
+        float sphere[4]; // bounding sphere (center, radius)
+        Block lods, meshlets, vertices, indices;
+    };
+    // index range of one level of detail, lod 0 is the full resolution mesh
+    struct Lod {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error; // world space simplification error
+        uint32_t reserved;
+    };
+    // cluster of up to 64 vertices and 124 triangles of lod 0
+    struct Meshlet {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t vertexCount;
+        uint32_t reserved;
+        float sphere[4];
+    };
+    static_assert(sizeof(Header) == 112 && sizeof(Lod) == 16 && sizeof(Meshlet) == 32);
+    constexpr uint64_t align(uint64_t offset) {
+        return (offset + blockAlignment - 1) & ~(blockAlignment - 1);
+    }
+
+    // read-only memory mapping of a mesh file, blocks are referenced in place
+    struct Mapping {
+        Mapping() = default;
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+        ~Mapping();
+        bool open(std::string_view path); // maps and validates the file
+        void close();
+
+        const Header& header() const { return *reinterpret_cast<const Header*>(pData); }
+        std::span<const std::byte> vertices() const { return block(header().vertices); }
+        std::span<const uint32_t> indices() const { return cast<uint32_t>(header().indices); }
+        std::span<const Lod> lods() const { return cast<Lod>(header().lods); }
+        std::span<const Meshlet> meshlets() const { return cast<Meshlet>(header().meshlets); }
+
+        const std::byte* pData = nullptr;
+        size_t size = 0;
+
+    private:
+        std::span<const std::byte> block(Block block) const { return std::span(pData + block.offset, block.size); }
+        template<typename T> std::span<const T> cast(Block block) const {
+            return std::span(reinterpret_cast<const T*>(pData + block.offset), block.size / sizeof(T));
+        }
+    };
+}
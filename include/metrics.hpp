@@ -0,0 +1,105 @@
+#pragma once
+//
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+// live metrics: counters, gauges and fixed-bucket histograms updated lock-free from the hot paths
+// a publisher thread copies them into a posix shared memory segment, guarded by a seqlock
+// read with: vulkan-renderer-metrics [--name /vulkan-renderer-metrics] [--watch ms] [--json]
+namespace Metrics {
+    constexpr uint32_t magic = 0x5254454d; // "METR"
+    constexpr uint32_t version = 1;
+    constexpr uint32_t maxMetrics = 64;
+    constexpr uint32_t nBuckets = 16;
+    constexpr uint32_t nameSize = 48;
+    constexpr std::string_view defaultName = "/vulkan-renderer-metrics";
+    // upper bucket bounds in ms for frame and wait times, the last bucket takes everything above
+    constexpr std::array<double, nBuckets> msBounds = { 0.1, 0.25, 0.5, 1, 2, 4, 6, 8, 12, 16.7, 25, 33.3, 50, 100, 250, 1e300 };
+
+    enum class Type : uint32_t { eCounter, eGauge, eHistogram };
+
+    // shared memory layout, also read by tools/metrics.cpp
+    struct Sample {
+        char name[nameSize]; // zero terminated
+        Type type;
+        uint32_t reserved;
+        double value; // counter total, gauge value or histogram sum
+        uint64_t count; // histogram samples
+        std::array<double, nBuckets> bounds;
+        std::array<uint64_t, nBuckets> buckets;
+    };
+    struct Segment {
+        uint32_t magic;
+        uint32_t version;
+        std::atomic<uint64_t> sequence; // odd while the publisher writes, readers retry if it changed during their copy
+        uint64_t publishTime; // ns since the unix epoch
+        uint32_t pid;
+        uint32_t nSamples;
+        std::array<Sample, maxMetrics> samples;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlock counter has to be lock free across processes");
+
+    struct Counter {
+        void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+        std::atomic<uint64_t> value = 0;
+    };
+    struct Gauge {
+        void set(double v) { value.store(v, std::memory_order_relaxed); }
+        std::atomic<double> value = 0.0;
+    };
+    struct Histogram {
+        void record(double v) {
+            uint32_t bucket = 0;
+            while (bucket + 1 < nBuckets && v > bounds[bucket]) bucket++;
+            buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(v, std::memory_order_relaxed);
+        }
+        std::array<double, nBuckets> bounds = msBounds; // set once at registration
+        std::array<std::atomic<uint64_t>, nBuckets> buckets = {};
+        std::atomic<uint64_t> count = 0;
+        std::atomic<double> sum = 0.0;
+    };
+    // records the time in ms until it goes out of scope
+    struct ScopedTimer {
+        ScopedTimer(Histogram& histogram): histogram(histogram), start(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer() { histogram.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()); }
+        Histogram& histogram;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // registration takes a lock and is meant for initialization, e.g. static locals at the call site
+    // the returned references stay valid for the lifetime of the process, the same name returns the same metric
+    // metrics past maxMetrics are still counted but not published
+    Counter& counter(std::string_view name);
+    Gauge& gauge(std::string_view name);
+    Histogram& histogram(std::string_view name, std::span<const double> bounds = msBounds);
+
+    // starts publishing every interval on a background thread, stopped at exit or by stop_publishing()
+    bool start_publishing(std::string_view name = defaultName, uint32_t intervalMs = 100);
+    void stop_publishing();
+
+    // seqlock read of a mapped segment, false if the publisher kept writing during every attempt
+    inline bool read(const Segment& segment, Segment& copy) {
+        for (uint32_t attempt = 0; attempt < 100; attempt++) {
+            uint64_t start = segment.sequence.load(std::memory_order_acquire);
+            if (start & 1) continue;
+            copy.magic = segment.magic;
+            copy.version = segment.version;
+            copy.publishTime = segment.publishTime;
+            copy.pid = segment.pid;
+            copy.nSamples = segment.nSamples;
+            copy.samples = segment.samples;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (segment.sequence.load(std::memory_order_relaxed) == start) {
+                copy.sequence.store(start, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,187 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.hpp>
+#include <fmt/base.h>
+//
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <future>
+#include <span>
+#include <string>
+#include <vector>
+//
+#include "vk_wrappers/image.hpp"
+#include "vk_wrappers/buffer.hpp"
+#include "vk_wrappers/pipeline.hpp"
+#include "vk_wrappers/queues.hpp"
+
+// ordered chain of compute passes applied to the renderer's hdr image
+struct PostProcess {
+    struct Pass {
+        std::string name;
+        Pipelines::Compute pipe;
+        vk::Extent3D groups;
+        std::vector<uint32_t> dependencies; // passes that need to be enabled for this pass to run
+        bool bEnabled = true;
+        bool bSupported = true; // required device features are present
+        bool bActive = true; // enabled, with all dependencies active
+        float time = 0.0f; // gpu time in ms
+    };
+    // push constants of bloom_extract.comp and bloom_composite.comp
+    struct BloomParams {
+        float threshold = 1.0f; // soft threshold for bright parts of the scene
+        float knee = 0.5f;
+        float intensity = 0.5f;
+    };
+
+    void init(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc, Image& scene) {
+        // luminance histogram (256 bins) followed by exposure and average log luminance
+        exposure = Buffer(alloc, 256 * sizeof(uint32_t) + 2 * sizeof(float), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst);
+        bExposureReset = true;
+
+        // keep pass toggles across renderer rebuilds
+        std::vector<bool> enabled;
+        for (Pass& pass : passes) enabled.push_back(pass.bEnabled);
+        passes.clear();
+        // bloom: extract bright parts, blur them separably and add them back onto the scene
+        add_pass("bloom_extract", {});
+        add_pass("blur_h", { 0 });
+        add_pass("blur_v", { 1 });
+        add_pass("bloom_composite", { 2 });
+        // auto exposure: histogram is cleared by the exposure pass, so they only run together
+        add_pass("histogram", { 5 });
+        add_pass("exposure", { 4 });
+        // tonemap: apply exposure and map hdr scene into displayable range
+        add_pass("tonemap", {});
+        for (uint32_t i = 0; i < enabled.size() && i < passes.size(); i++) passes[i].bEnabled = enabled[i];
+
+        // histogram and exposure rely on subgroup ballot/arithmetic in compute shaders
+        auto [props, subgroupProps] = physDevice.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceSubgroupProperties>();
+        vk::SubgroupFeatureFlags subgroupOps = vk::SubgroupFeatureFlagBits::eBasic | vk::SubgroupFeatureFlagBits::eBallot | vk::SubgroupFeatureFlagBits::eArithmetic;
+        bool bSubgroups = (subgroupProps.supportedStages & vk::ShaderStageFlagBits::eCompute)
+            && (subgroupProps.supportedOperations & subgroupOps) == subgroupOps;
+        if (!bSubgroups) fmt::println("subgroup operations unsupported, auto exposure disabled");
+
+        // compile all pipelines in parallel
+        std::vector<std::future<void>> tasks;
+        for (Pass& pass : passes) {
+            if (!bSubgroups && (pass.name == "histogram" || pass.name == "exposure")) {
+                pass.bSupported = false;
+                continue;
+            }
+            tasks.push_back(std::async(std::launch::async, [&] { pass.pipe.init(device); }));
+        }
+        for (auto& task : tasks) task.get();
+        create_targets(device, alloc, scene);
+    }
+    // replaces the bloom images after the scene was resized, pipelines and exposure state are kept
+    // the old images and the descriptor pools in-flight frames still bind are retired on the queue
+    void resize(vk::raii::Device& device, vma::UniqueAllocator& alloc, Queue& queue, Image& scene) {
+        for (Image& image : bloom) queue.retire(std::move(image));
+        for (Pass& pass : passes) {
+            if (pass.bSupported) queue.retire(pass.pipe.cs.reallocate(device));
+        }
+        create_targets(device, alloc, scene);
+    }
+    // writes a timestamp into pQueryPool at firstQuery + i after pass i (skipped passes included)
+    void execute(vk::raii::CommandBuffer& cmd, BindState& state, vk::raii::QueryPool* pQueryPool, uint32_t firstQuery) {
+        for (Image& image : bloom) {
+            if (image.lastKnownLayout == vk::ImageLayout::eGeneral) continue;
+            image.transition_layout_r_to_w(cmd, vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits2::eAllCommands, vk::PipelineStageFlagBits2::eComputeShader);
+        }
+        if (bExposureReset) {
+            // empty histogram, exposure of 1 and average log luminance of 0
+            bExposureReset = false;
+            cmd.fillBuffer(*exposure.buffer, 0, 256 * sizeof(uint32_t), 0);
+            cmd.fillBuffer(*exposure.buffer, 256 * sizeof(uint32_t), sizeof(float), std::bit_cast<uint32_t>(1.0f));
+            cmd.fillBuffer(*exposure.buffer, 256 * sizeof(uint32_t) + sizeof(float), sizeof(float), 0);
+            barrier(cmd, vk::PipelineStageFlagBits2::eClear);
+        }
+
+        update_active();
+        for (uint32_t i = 0; i < passes.size(); i++) {
+            Pass& pass = passes[i];
+            if (pass.bActive) {
+                if (pass.name.starts_with("bloom")) pass.pipe.push_constants(cmd, bloomParams);
+                pass.pipe.execute(cmd, state, pass.groups.width, pass.groups.height, pass.groups.depth);
+                barrier(cmd, vk::PipelineStageFlagBits2::eComputeShader);
+            }
+            if (pQueryPool != nullptr) cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eComputeShader, **pQueryPool, firstQuery + i);
+        }
+    }
+    // stamps[0] is the timestamp before the first pass, followed by one per pass
+    void read_times(std::span<const uint64_t> stamps, float timestampPeriod) {
+        for (uint32_t i = 0; i < passes.size() && i + 1 < stamps.size(); i++) {
+            passes[i].time = (float)(stamps[i + 1] - stamps[i]) * timestampPeriod / 1'000'000.0f;
+        }
+    }
+
+    std::vector<Pass> passes;
+    BloomParams bloomParams;
+
+private:
+    void add_pass(std::string_view name, std::vector<uint32_t> dependencies) {
+        passes.push_back(Pass{ std::string(name), Pipelines::Compute(name), vk::Extent3D(), dependencies });
+    }
+    void create_targets(vk::raii::Device& device, vma::UniqueAllocator& alloc, Image& scene) {
+        // ping-pong images for bloom at half resolution
+        vk::Extent3D extent = scene.extent;
+        vk::Extent3D bloomExtent = vk::Extent3D(std::max(extent.width / 2, 1u), std::max(extent.height / 2, 1u), 1);
+        for (Image& image : bloom) image = Image(device, alloc, bloomExtent, scene.format, vk::ImageUsageFlagBits::eStorage, vk::ImageAspectFlagBits::eColor);
+        passes[0].groups = group_count(bloomExtent, 16, 16);
+        passes[1].groups = group_count(bloomExtent, 256, 1);
+        passes[2].groups = group_count(bloomExtent, 1, 256);
+        passes[3].groups = group_count(extent, 16, 16);
+        passes[4].groups = group_count(extent, 16, 16);
+        passes[5].groups = vk::Extent3D(1, 1, 1);
+        passes[6].groups = group_count(extent, 16, 16);
+
+        // bind pass inputs (binding 0) and outputs (binding 1)
+        passes[0].pipe.cs.write_descriptor(scene, 0, 0);
+        passes[0].pipe.cs.write_descriptor(bloom[0], 0, 1);
+        passes[1].pipe.cs.write_descriptor(bloom[0], 0, 0);
+        passes[1].pipe.cs.write_descriptor(bloom[1], 0, 1);
+        passes[2].pipe.cs.write_descriptor(bloom[1], 0, 0);
+        passes[2].pipe.cs.write_descriptor(bloom[0], 0, 1);
+        passes[3].pipe.cs.write_descriptor(scene, 0, 0);
+        passes[3].pipe.cs.write_descriptor(bloom[0], 0, 1);
+        if (passes[4].bSupported) {
+            passes[4].pipe.cs.write_descriptor(scene, 0, 0);
+            passes[4].pipe.cs.write_descriptor(exposure, 0, 1);
+            passes[5].pipe.cs.write_descriptor(exposure, 0, 0);
+        }
+        passes[6].pipe.cs.write_descriptor(scene, 0, 0);
+        passes[6].pipe.cs.write_descriptor(exposure, 0, 1);
+    }
+    static vk::Extent3D group_count(vk::Extent3D extent, uint32_t x, uint32_t y) {
+        return vk::Extent3D((extent.width + x - 1) / x, (extent.height + y - 1) / y, 1);
+    }
+    // deactivate passes until all dependencies are satisfied (dependencies may be mutual)
+    void update_active() {
+        for (Pass& pass : passes) pass.bActive = pass.bEnabled && pass.bSupported;
+        for (bool bChanged = true; bChanged;) {
+            bChanged = false;
+            for (Pass& pass : passes) {
+                if (!pass.bActive) continue;
+                pass.bActive = std::all_of(pass.dependencies.begin(), pass.dependencies.end(), [&](uint32_t dep) { return passes[dep].bActive; });
+                bChanged |= !pass.bActive;
+            }
+        }
+    }
+    // all pass resources stay in general layout, so a global memory barrier covers images and buffers alike
+    void barrier(vk::raii::CommandBuffer& cmd, vk::PipelineStageFlags2 srcStage) {
+        vk::MemoryBarrier2 memBarrier = vk::MemoryBarrier2()
+            .setSrcStageMask(srcStage)
+            .setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite);
+        vk::DependencyInfo depInfo = vk::DependencyInfo()
+            .setMemoryBarriers(memBarrier);
+        cmd.pipelineBarrier2(depInfo);
+    }
+
+    std::array<Image, 2> bloom;
+    Buffer exposure;
+    bool bExposureReset = true;
+};
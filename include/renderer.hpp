@@ -2,17 +2,53 @@
 #include <vulkan/vulkan_raii.hpp>
 #include <vk_mem_alloc.hpp>
 #include <fmt/base.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 //
 #include <array>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
 //
+#include "batch.hpp"
+#include "capture.hpp"
+#include "culling.hpp"
+#include "metrics.hpp"
+#include "postprocess.hpp"
 #include "vk_wrappers/queues.hpp"
 #include "vk_wrappers/swapchain.hpp"
 #include "vk_wrappers/image.hpp"
 #include "vk_wrappers/pipeline.hpp"
+#include "vk_wrappers/sampler.hpp"
+#include "vk_wrappers/tasks.hpp"
+#include "vk_wrappers/texture.hpp"
 
 struct Renderer {
-    void init(vk::raii::Device& device, vma::UniqueAllocator& alloc, Queues& queues, vk::Extent2D extent) {
+    Renderer() = default;
+    Renderer(const Renderer&) = delete; // batches point at meshPipe, so the renderer stays in place and is resized instead
+    Renderer& operator=(const Renderer&) = delete;
+
+    void reflect() {
+        computePipe.reflect();
+        meshPipe.reflect();
+        culling.reflect();
+    }
+    void init(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc, Queues& queues, vk::Extent2D extent) {
+        // check for gpu timestamp support on the graphics queue
+        timestampPeriod = physDevice.getProperties().limits.timestampPeriod;
+        bTimestamps = physDevice.getQueueFamilyProperties()[queues.graphics.index].timestampValidBits > 0;
+
+        create_targets(device, alloc, extent);
+
+        // create shader pipelines
+        computePipe.init(device);
+        meshPipe.init(device, image.format, depth.format);
+        init_scene(device, physDevice, alloc, extent);
+        write_descriptors();
+        postProcess.init(physDevice, device, alloc, image);
+
         // create FrameData objects
         for (uint32_t i = 0; i < frames.size(); i++) {
             vk::CommandPoolCreateInfo poolInfo = vk::CommandPoolCreateInfo()
@@ -33,67 +69,285 @@ struct Renderer {
                 .setPNext(&typeInfo);
             frames[i].timeline = device.createSemaphore(semaInfo);
             frames[i].timelineLast = typeInfo.initialValue;
-        }
 
-        // create image with 16 bits color depth
-        vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eStorage;
-        image = Image(device, alloc, vk::Extent3D(extent, 1), vk::Format::eR16G16B16A16Sfloat, usage, vk::ImageAspectFlagBits::eColor);
-
-        // create shader pipeline
-        computePipe.init(device);
-        computePipe.cs.write_descriptor(image, 0, 0);
+            if (!bTimestamps) continue;
+            // frame start, scene end, one per post process pass, frame end
+            nQueries = 3 + postProcess.passes.size();
+            vk::QueryPoolCreateInfo queryInfo = vk::QueryPoolCreateInfo()
+                .setQueryType(vk::QueryType::eTimestamp)
+                .setQueryCount(nQueries);
+            frames[i].queryPool = device.createQueryPool(queryInfo);
+        }
+    }
+    // replaces only what depends on the extent: color and depth images, camera, depth pyramid and post process targets
+    // pipelines, meshes and textures are kept, replaced resources and descriptor pools are retired on the graphics timeline
+    void resize(vk::raii::Device& device, vma::UniqueAllocator& alloc, Queues& queues, vk::Extent2D extent) {
+        Queue& queue = queues.graphics;
+        queue.retire(std::move(image));
+        queue.retire(std::move(depth));
+        queue.retire(std::move(camera));
+        create_targets(device, alloc, extent);
+        write_camera(alloc, extent);
+        queue.retire(computePipe.cs.reallocate(device));
+        queue.retire(meshPipe.vs.reallocate(device));
+        write_descriptors();
+        culling.resize(device, alloc, queue, batch, depth, view, proj, zNear, zFar);
+        postProcess.resize(device, alloc, queue, image);
     }
     void render(vk::raii::Device& device, Swapchain& swapchain, Queues& queues) {
+        FrameData& frame = submit(device, queues);
+        
+        // present drawn image
+        swapchain.present(device, image, frame.timeline, frame.timelineLast); 
+    }
+    void render(vk::raii::Device& device, Queues& queues) {
+        // headless rendering without presentation
+        submit(device, queues);
+    }
+    // reads back every rendered frame until the capture is stopped, the capture has to outlive its use here
+    bool start_capture(Capture& capture, vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc, Tasks::Scheduler& tasks,
+            std::string_view path, uint32_t nFrames = 0) {
+        pCapture = &capture;
+        return capture.start(physDevice, device, alloc, tasks, image, path, nFrames);
+    }
+    
+    float gpuTime = 0.0f; // gpu time in ms of the most recently completed frame
+    bool bMeshes = true; // draw mesh batches on top of the gradient
+    bool bCulling = true; // gpu frustum and occlusion culling of mesh batches
+    std::string meshPath; // optional mesh file drawn in the scene, set before init()
+    std::string texturePath; // optional ktx2 detail texture of the meshes, set before init()
+    bool bDirectUploads = false; // write resources in place instead of through staging copies (unified memory), set before init()
+    PostProcess postProcess;
+    
+private:
+    struct FrameData;
+    FrameData& submit(vk::raii::Device& device, Queues& queues) {
         FrameData& frame = frames[iFrame++ % frames.size()];
 
-        // wait for command buffer execution
-        while (vk::Result::eTimeout == device.waitSemaphores(vk::SemaphoreWaitInfo({}, *frame.timeline, frame.timelineLast), UINT64_MAX)) {}
-        frame.reset_timeline(device);
+        // wait for command buffer execution, then free whatever was retired up to this point
+        static Metrics::Histogram& waitTime = Metrics::histogram("render_wait_ms");
+        static Metrics::Counter& submits = Metrics::counter("queue_submits");
+        {
+            Metrics::ScopedTimer timer(waitTime);
+            while (vk::Result::eTimeout == device.waitSemaphores(vk::SemaphoreWaitInfo({}, *frame.timeline, frame.timelineLast), UINT64_MAX)) {}
+        }
+        queues.graphics.collect();
+        read_timestamps(frame);
 
         // record command buffer
         vk::raii::CommandBuffer& cmd = frame.commandBuffer;
         vk::CommandBufferBeginInfo cmdBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
         cmd.begin(cmdBeginInfo);
-        draw(device, cmd);
+        frame.bindState.reset();
+        if (bTimestamps) {
+            cmd.resetQueryPool(*frame.queryPool, 0, nQueries);
+            cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *frame.queryPool, 0);
+        }
+        draw(cmd, frame, queues.graphics);
+        if (bTimestamps) {
+            cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, *frame.queryPool, nQueries - 1);
+            frame.bQueried = true;
+        }
         cmd.end();
 
-        // submit command buffer
-        vk::TimelineSemaphoreSubmitInfo timelineInfo({}, ++frame.timelineLast);
+        // submit command buffer, signaling the queue's timeline for retired resources and capture readbacks
+        std::array<vk::Semaphore, 2> signalSemas = { *frame.timeline, *queues.graphics.timeline };
+        std::array<uint64_t, 2> signalValues = { ++frame.timelineLast, ++queues.graphics.timelineValue };
+        vk::TimelineSemaphoreSubmitInfo timelineInfo = vk::TimelineSemaphoreSubmitInfo()
+            .setSignalSemaphoreValues(signalValues);
         vk::SubmitInfo submitInfo = vk::SubmitInfo()
             .setPNext(&timelineInfo)
-            .setSignalSemaphores(*frame.timeline)
+            .setSignalSemaphores(signalSemas)
             .setCommandBuffers(*cmd);
         queues.graphics.queue.submit(submitInfo);
-        
-        // present drawn image
-        swapchain.present(device, image, frame.timeline, frame.timelineLast); 
+        submits.add();
+        return frame;
     }
-    
-private:
-    void draw(vk::raii::Device& device, vk::raii::CommandBuffer& cmd) {
+    void read_timestamps(FrameData& frame) {
+        // frame is known to be complete at this point
+        if (!frame.bQueried) return;
+        auto [result, stamps] = frame.queryPool.getResults<uint64_t>(0, nQueries, nQueries * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess) return;
+        gpuTime = (float)(stamps.back() - stamps.front()) * timestampPeriod / 1'000'000.0f;
+        postProcess.read_times(std::span(stamps).subspan(1, postProcess.passes.size() + 1), timestampPeriod);
+    }
+    void draw(vk::raii::CommandBuffer& cmd, FrameData& frame, Queue& queue) {
         // utils::transition_layout_r_to_w(cmd, swapchain.images[index], vk::ImageLayout::eUndefined, vk::ImageLayout::eAttachmentOptimal);
         // utils::transition_layout_w_to_r(cmd, swapchain.images[index], vk::ImageLayout::eUndefined, vk::ImageLayout::eReadOnlyOptimal);
         
         image.transition_layout_r_to_w(cmd, vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits2::eAllCommands, vk::PipelineStageFlagBits2::eComputeShader);
-        computePipe.execute(cmd, std::ceil(image.extent.width / 16.0f), std::ceil(image.extent.height / 16.0f), 1);
+        computePipe.execute(cmd, frame.bindState, std::ceil(image.extent.width / 16.0f), std::ceil(image.extent.height / 16.0f), 1);
+        if (bMeshes) {
+            batch.prepare(cmd, queue);
+            detail.prepare(cmd, queue);
+            if (bCulling) culling.execute(cmd, frame.bindState, batch);
+            draw_meshes(cmd, frame.bindState);
+            if (bCulling) culling.build_pyramid(cmd, frame.bindState, depth);
+        }
+        else image.transition_layout_w_to_rw(cmd, vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits2::eComputeShader, vk::PipelineStageFlagBits2::eComputeShader);
+        if (bTimestamps) cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eComputeShader, *frame.queryPool, 1);
+
+        // apply post processing chain
+        postProcess.execute(cmd, frame.bindState, bTimestamps ? &frame.queryPool : nullptr, 2);
+        if (pCapture != nullptr) pCapture->record(cmd, image, queue);
+    }
+    void create_targets(vk::raii::Device& device, vma::UniqueAllocator& alloc, vk::Extent2D extent) {
+        // create image with 16 bits color depth
+        vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eStorage;
+        image = Image(device, alloc, vk::Extent3D(extent, 1), vk::Format::eR16G16B16A16Sfloat, usage, vk::ImageAspectFlagBits::eColor);
+        depth = Image(device, alloc, vk::Extent3D(extent, 1), vk::Format::eD32Sfloat, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled, vk::ImageAspectFlagBits::eDepth);
+    }
+    void write_descriptors() {
+        computePipe.cs.write_descriptor(image, 0, 0);
+        meshPipe.vs.write_descriptor(camera, 0, 0);
+        meshPipe.vs.write_descriptor(batch.objectBuffer, 0, 1);
+        meshPipe.vs.write_descriptor(*detail.image.view, detailSampler, 0, 2);
+    }
+    void draw_meshes(vk::raii::CommandBuffer& cmd, BindState& state) {
+        image.transition_layout_w_to_rw(cmd, vk::ImageLayout::eAttachmentOptimal, vk::PipelineStageFlagBits2::eComputeShader, vk::PipelineStageFlagBits2::eColorAttachmentOutput);
+        // depth is cleared every frame, so its previous contents can be discarded
+        depth.lastKnownLayout = vk::ImageLayout::eUndefined;
+        depth.transition_layout_w_to_rw(cmd, vk::ImageLayout::eAttachmentOptimal,
+            vk::PipelineStageFlagBits2::eLateFragmentTests | vk::PipelineStageFlagBits2::eComputeShader,
+            vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests);
+
+        // draw on top of the gradient
+        vk::Extent2D extent = vk::Extent2D(image.extent.width, image.extent.height);
+        vk::RenderingAttachmentInfo colorInfo = vk::RenderingAttachmentInfo()
+            .setImageView(*image.view)
+            .setImageLayout(vk::ImageLayout::eAttachmentOptimal)
+            .setLoadOp(vk::AttachmentLoadOp::eLoad)
+            .setStoreOp(vk::AttachmentStoreOp::eStore);
+        vk::RenderingAttachmentInfo depthInfo = vk::RenderingAttachmentInfo()
+            .setImageView(*depth.view)
+            .setImageLayout(vk::ImageLayout::eAttachmentOptimal)
+            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setStoreOp(vk::AttachmentStoreOp::eStore) // reduced into the culling depth pyramid
+            .setClearValue(vk::ClearDepthStencilValue(1.0f, 0));
+        vk::RenderingInfo renderInfo = vk::RenderingInfo()
+            .setRenderArea(vk::Rect2D({ 0, 0 }, extent))
+            .setLayerCount(1)
+            .setColorAttachments(colorInfo)
+            .setPDepthAttachment(&depthInfo);
+        cmd.beginRendering(renderInfo);
+        batch.draw(cmd, state, extent, bCulling);
+        cmd.endRendering();
+        image.transition_layout_w_to_rw(cmd, vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::PipelineStageFlagBits2::eComputeShader);
+    }
+    void init_scene(vk::raii::Device& device, vk::raii::PhysicalDevice& physDevice, vma::UniqueAllocator& alloc, vk::Extent2D extent) {
+        // grid of objects, every object is its own indirect draw command
+        auto loadStart = std::chrono::steady_clock::now();
+        auto [cubeVertices, cubeIndices] = Meshes::cube();
+        auto [octVertices, octIndices] = Meshes::octahedron();
+        std::array<uint32_t, 2> meshes = { batch.add_mesh(cubeVertices, cubeIndices), batch.add_mesh(octVertices, octIndices) };
+        // optionally replace the octahedra with a mesh file, normalized to the same size
+        MeshFile::Mapping meshFile;
+        glm::mat4 meshTransform = glm::mat4(1.0f);
+        if (!meshPath.empty() && meshFile.open(meshPath)) {
+            uint32_t mesh = batch.add_mesh(meshFile);
+            if (mesh != UINT32_MAX) {
+                const float* sphere = meshFile.header().sphere;
+                meshes[1] = mesh;
+                meshTransform = glm::scale(glm::mat4(1.0f), glm::vec3(0.5f / sphere[3]));
+                meshTransform = glm::translate(meshTransform, -glm::vec3(sphere[0], sphere[1], sphere[2]));
+            }
+        }
+        constexpr int32_t gridSize = 100;
+        for (int32_t x = 0; x < gridSize; x++) {
+            for (int32_t z = 0; z < gridSize; z++) {
+                glm::vec3 position = glm::vec3(x - gridSize / 2, 0, z - gridSize / 2) * 3.0f;
+                glm::vec4 color = glm::vec4((float)x / gridSize, 0.5f, (float)z / gridSize, 1.0f);
+                uint32_t mesh = (x + z) % 2;
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+                batch.add_object(meshPipe, meshes[mesh], mesh == 1 ? model * meshTransform : model, color);
+            }
+        }
+        // wall hiding part of the grid from the camera
+        glm::mat4 wall = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 6.0f, 45.0f)), glm::vec3(80.0f, 12.0f, 1.0f));
+        batch.add_object(meshPipe, meshes[0], wall, glm::vec4(0.6f, 0.6f, 0.6f, 1.0f));
+        batch.upload(physDevice, alloc, bDirectUploads);
+        if (meshFile.pData != nullptr) {
+            // the file is copied into staging memory by upload(), after which the mapping can be closed
+            float loadTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+            fmt::println("{}: {} vertices, {} indices loaded in {:.2f} ms", meshPath, meshFile.header().vertexCount, meshFile.header().indexCount, loadTime);
+        }
+
+        write_camera(alloc, extent);
+        culling.init(device, alloc, samplers, batch, depth, view, proj, zNear, zFar);
+        init_texture(device, physDevice, alloc);
+    }
+    // static camera looking across the grid, the projection follows the aspect ratio
+    void write_camera(vma::UniqueAllocator& alloc, vk::Extent2D extent) {
+        struct CameraData {
+            glm::mat4 viewProj;
+            glm::vec4 lightDir;
+        };
+        view = glm::lookAt(glm::vec3(0.0f, 30.0f, 90.0f), glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        proj = glm::perspectiveRH_ZO(glm::radians(60.0f), (float)extent.width / (float)extent.height, zNear, zFar);
+        proj[1][1] *= -1.0f; // vulkan clip space has y pointing down
+        CameraData cameraData = { proj * view, glm::vec4(glm::normalize(glm::vec3(-0.3f, -1.0f, -0.5f)), 0.0f) };
+        camera = Buffer(alloc, sizeof(CameraData), vk::BufferUsageFlagBits::eStorageBuffer,
+            vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped);
+        std::memcpy(camera.pMapped, &cameraData, sizeof(CameraData));
+        alloc->flushAllocation(*camera.allocation, 0, vk::WholeSize);
+    }
+    void init_texture(vk::raii::Device& device, vk::raii::PhysicalDevice& physDevice, vma::UniqueAllocator& alloc) {
+        // detail texture, a procedural checkerboard unless a ktx2 file is given
+        detail.bDirect = bDirectUploads;
+        if (texturePath.empty() || !detail.load_ktx2(physDevice, device, alloc, texturePath)) {
+            constexpr uint32_t size = 256, nTiles = 8;
+            std::vector<uint8_t> pixels(size * size * 4);
+            for (uint32_t y = 0; y < size; y++) {
+                for (uint32_t x = 0; x < size; x++) {
+                    uint8_t value = (x * nTiles / size + y * nTiles / size) % 2 ? 255 : 160;
+                    std::memset(&pixels[(y * size + x) * 4], value, 4);
+                }
+            }
+            detail.load_rgba(physDevice, device, alloc, pixels, vk::Extent2D(size, size));
+        }
+        // trilinear filtering, anisotropic where supported since the grid is viewed at grazing angles
+        vk::SamplerCreateInfo samplerInfo = vk::SamplerCreateInfo()
+            .setMagFilter(vk::Filter::eLinear)
+            .setMinFilter(vk::Filter::eLinear)
+            .setMipmapMode(vk::SamplerMipmapMode::eLinear)
+            .setAddressModeU(vk::SamplerAddressMode::eRepeat)
+            .setAddressModeV(vk::SamplerAddressMode::eRepeat)
+            .setAddressModeW(vk::SamplerAddressMode::eRepeat)
+            .setMaxLod(vk::LodClampNone);
+        if (physDevice.getFeatures().samplerAnisotropy) {
+            samplerInfo.setAnisotropyEnable(true)
+                .setMaxAnisotropy(std::min(16.0f, physDevice.getProperties().limits.maxSamplerAnisotropy));
+        }
+        detailSampler = samplers.get(device, samplerInfo);
     }
 
 private:
     struct FrameData {
-        void reset_timeline(vk::raii::Device& device) {
-            vk::SemaphoreTypeCreateInfo typeInfo(vk::SemaphoreType::eTimeline, 0);
-            vk::SemaphoreCreateInfo semaInfo({}, &typeInfo);
-            timeline = device.createSemaphore(semaInfo);
-            timelineLast = typeInfo.initialValue;
-        }
         vk::raii::CommandPool commandPool = nullptr;
         vk::raii::CommandBuffer commandBuffer = nullptr;
-        vk::raii::Semaphore timeline = nullptr;
+        vk::raii::Semaphore timeline = nullptr; // signaled by the frame's submission and its present
         uint64_t timelineLast;
+        vk::raii::QueryPool queryPool = nullptr;
+        bool bQueried = false;
+        BindState bindState;
     };
     std::array<FrameData, 2> frames; // double buffering
     uint32_t iFrame = 0;
+    float timestampPeriod = 1.0f;
+    uint32_t nQueries = 0;
+    bool bTimestamps = false;
+    Capture* pCapture = nullptr;
 
     Image image;
+    Image depth;
+    Buffer camera;
+    glm::mat4 view, proj;
+    static constexpr float zNear = 0.1f, zFar = 500.0f;
+    SamplerCache samplers;
+    Texture detail;
+    vk::Sampler detailSampler;
+    MeshBatch batch;
+    Culling culling;
     Pipelines::Compute computePipe = Pipelines::Compute("gradient.comp");
+    Pipelines::Graphics meshPipe = Pipelines::Graphics("mesh.vert", "mesh.frag");
 };
\ No newline at end of file
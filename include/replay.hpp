@@ -0,0 +1,176 @@
+#pragma once
+#include <SDL3/SDL_events.h>
+#include <fmt/base.h>
+#include <fmt/format.h>
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// deterministic input record and replay
+// record: vulkan-renderer --record session.input
+// replay: vulkan-renderer --replay session.input [--headless] [--uncapped] [--timings frames.csv]
+// log layout: Header, then Records in order, each event record followed by its payload (the leading bytes of the SDL_Event)
+// a frame record closes the events polled during one frame, replay feeds them back on the same frame
+namespace Replay {
+    using Clock = std::chrono::steady_clock;
+    constexpr uint32_t magic = 0x4c504552; // "REPL"
+    constexpr uint32_t version = 1;
+    constexpr uint32_t frameMarker = UINT32_MAX;
+    constexpr uint16_t frameUiUpdate = 1; // frame flag: the ui was updated (rate cap) during this frame
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width, height; // window size in pixels while recording
+    };
+    struct Record {
+        uint32_t type; // SDL_EventType or frameMarker
+        uint16_t size; // payload bytes
+        uint16_t flags; // frame flags
+        uint64_t time; // ns since the recording started
+    };
+    static_assert(sizeof(Header) == 16 && sizeof(Record) == 16);
+
+    // payload bytes of recorded event types, 0 for events that depend on the real window and are not recorded
+    inline uint16_t payload_size(uint32_t type) {
+        switch (type) {
+            case SDL_EventType::SDL_EVENT_QUIT: return sizeof(SDL_QuitEvent);
+            case SDL_EventType::SDL_EVENT_KEY_UP:
+            case SDL_EventType::SDL_EVENT_KEY_DOWN: return sizeof(SDL_KeyboardEvent);
+            case SDL_EventType::SDL_EVENT_MOUSE_MOTION: return sizeof(SDL_MouseMotionEvent);
+            case SDL_EventType::SDL_EVENT_MOUSE_BUTTON_UP:
+            case SDL_EventType::SDL_EVENT_MOUSE_BUTTON_DOWN: return sizeof(SDL_MouseButtonEvent);
+            case SDL_EventType::SDL_EVENT_MOUSE_WHEEL: return sizeof(SDL_MouseWheelEvent);
+            case SDL_EventType::SDL_EVENT_WINDOW_FOCUS_LOST: return sizeof(SDL_WindowEvent);
+            default: return 0;
+        }
+    }
+
+    struct Recorder {
+        bool open(std::string_view path, uint32_t width, uint32_t height) {
+            file.open(std::string(path), std::ios::binary | std::ios::trunc);
+            if (!file) {
+                fmt::println("could not open input recording: {}", path);
+                return false;
+            }
+            Header header = { magic, version, width, height };
+            file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            start = Clock::now();
+            return true;
+        }
+        void event(const SDL_Event& event) {
+            uint16_t size = payload_size(event.type);
+            if (!file.is_open() || size == 0) return;
+            write(event.type, size, 0);
+            file.write(reinterpret_cast<const char*>(&event), size);
+        }
+        void frame(bool bUiUpdate) {
+            if (!file.is_open()) return;
+            write(frameMarker, 0, bUiUpdate ? frameUiUpdate : 0);
+            nFrames++;
+        }
+        void close() {
+            if (!file.is_open()) return;
+            file.close();
+            fmt::println("recorded {} frames of input", nFrames);
+        }
+
+        uint32_t nFrames = 0;
+
+    private:
+        void write(uint32_t type, uint16_t size, uint16_t flags) {
+            uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            Record record = { type, size, flags, time };
+            file.write(reinterpret_cast<const char*>(&record), sizeof(Record));
+        }
+        std::ofstream file;
+        Clock::time_point start;
+    };
+
+    struct Player {
+        bool open(std::string_view path) {
+            file.open(std::string(path), std::ios::binary);
+            file.read(reinterpret_cast<char*>(&header), sizeof(Header));
+            if (!file || header.magic != magic || header.version != version) {
+                fmt::println("invalid input recording: {}", path);
+                file.close();
+                return false;
+            }
+            return true;
+        }
+        bool is_open() const { return file.is_open(); }
+        // events of the next recorded frame with their window ids replaced, false once the log is exhausted
+        bool next_frame(std::vector<SDL_Event>& events, uint32_t windowID) {
+            events.clear();
+            Record record;
+            while (file.read(reinterpret_cast<char*>(&record), sizeof(Record))) {
+                if (record.type == frameMarker) {
+                    bUiUpdate = record.flags & frameUiUpdate;
+                    frameTime = std::chrono::nanoseconds(record.time);
+                    nFrames++;
+                    return true;
+                }
+                SDL_Event& event = events.emplace_back();
+                std::memset(&event, 0, sizeof(SDL_Event));
+                file.read(reinterpret_cast<char*>(&event), std::min<size_t>(record.size, sizeof(SDL_Event)));
+                file.ignore(record.size > sizeof(SDL_Event) ? record.size - sizeof(SDL_Event) : 0);
+                // the replaying window differs from the recording one, imgui drops events of unknown windows
+                switch (event.type) {
+                    case SDL_EventType::SDL_EVENT_KEY_UP: case SDL_EventType::SDL_EVENT_KEY_DOWN: event.key.windowID = windowID; break;
+                    case SDL_EventType::SDL_EVENT_MOUSE_MOTION: event.motion.windowID = windowID; break;
+                    case SDL_EventType::SDL_EVENT_MOUSE_BUTTON_UP: case SDL_EventType::SDL_EVENT_MOUSE_BUTTON_DOWN: event.button.windowID = windowID; break;
+                    case SDL_EventType::SDL_EVENT_MOUSE_WHEEL: event.wheel.windowID = windowID; break;
+                    case SDL_EventType::SDL_EVENT_WINDOW_FOCUS_LOST: event.window.windowID = windowID; break;
+                    default: break;
+                }
+            }
+            // events after the last frame marker belong to an incomplete frame
+            file.close();
+            return false;
+        }
+
+        Header header = {};
+        std::chrono::nanoseconds frameTime = {}; // end of the current frame relative to the recording start
+        bool bUiUpdate = false; // whether the ui was updated during the current frame
+        uint32_t nFrames = 0;
+
+    private:
+        std::ifstream file;
+    };
+
+    // per-frame cpu and gpu times, written as csv
+    struct Timings {
+        void frame(float gpuTime) {
+            Clock::time_point now = Clock::now();
+            if (last != Clock::time_point()) {
+                cpuTimes.push_back(std::chrono::duration<float, std::milli>(now - last).count());
+                gpuTimes.push_back(gpuTime);
+            }
+            last = now;
+        }
+        void report(std::string_view path) {
+            if (cpuTimes.empty()) return;
+            std::vector<float> sorted = cpuTimes;
+            std::sort(sorted.begin(), sorted.end());
+            float mean = 0.0f;
+            for (float time : sorted) mean += time / sorted.size();
+            fmt::println("replay: {} frames, cpu mean {:.3f} ms, median {:.3f} ms, p99 {:.3f} ms",
+                sorted.size(), mean, sorted[sorted.size() / 2], sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)]);
+            if (path.empty()) return;
+
+            // gpu time is the most recently completed frame, which lags behind by the frames in flight
+            std::string csv = "frame,cpu_ms,gpu_ms\n";
+            for (size_t i = 0; i < cpuTimes.size(); i++) csv += fmt::format("{},{:.4f},{:.4f}\n", i, cpuTimes[i], gpuTimes[i]);
+            std::ofstream(std::string(path)) << csv;
+        }
+
+        std::vector<float> cpuTimes, gpuTimes;
+        Clock::time_point last;
+    };
+}
@@ -0,0 +1,81 @@
+#pragma once
+//
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+// bounded single producer single consumer ring, push and pop never block or allocate
+// each side keeps a cached copy of the other side's index to avoid touching its cache line on every call
+template<typename T, size_t capacity> struct SpscQueue {
+    static_assert(std::has_single_bit(capacity), "capacity has to be a power of two");
+
+    // producer thread only, false if the queue is full
+    bool push(const T& item) {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        if (head - cachedTail == capacity) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (head - cachedTail == capacity) return false;
+        }
+        items[head & (capacity - 1)] = item;
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+    // consumer thread only, false if the queue is empty
+    bool pop(T& item) {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail == cachedHead) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (tail == cachedHead) return false;
+        }
+        item = items[tail & (capacity - 1)];
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // producer line
+    alignas(64) std::atomic<size_t> head = 0;
+    size_t cachedTail = 0;
+    // consumer line
+    alignas(64) std::atomic<size_t> tail = 0;
+    size_t cachedHead = 0;
+    alignas(64) std::array<T, capacity> items = {};
+};
+
+// bounded single producer single consumer ring of plain values with bulk reads and writes
+// the capacity is rounded up to a power of two and fixed before either side starts
+template<typename T> struct SpscRing {
+    void resize(size_t minCapacity) {
+        items.assign(std::bit_ceil(minCapacity), T());
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+    size_t capacity() const { return items.size(); }
+
+    // producer thread only, returns the number of values written
+    size_t write(const T* pItems, size_t count) {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        count = std::min(count, capacity() - (head - tail.load(std::memory_order_acquire)));
+        for (size_t i = 0; i < count; i++) items[(head + i) & (capacity() - 1)] = pItems[i];
+        this->head.store(head + count, std::memory_order_release);
+        return count;
+    }
+    size_t writable() const { return capacity() - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire)); }
+    // consumer thread only, returns the number of values read
+    size_t read(T* pItems, size_t count) {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        count = std::min(count, head.load(std::memory_order_acquire) - tail);
+        for (size_t i = 0; i < count; i++) pItems[i] = items[(tail + i) & (capacity() - 1)];
+        this->tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+    size_t readable() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed); }
+
+private:
+    alignas(64) std::atomic<size_t> head = 0;
+    alignas(64) std::atomic<size_t> tail = 0;
+    std::vector<T> items;
+};
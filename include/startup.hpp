@@ -0,0 +1,48 @@
+#pragma once
+#include <fmt/base.h>
+#include <fmt/format.h>
+//
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// measures the duration of each engine startup stage and the time until the first frame was presented
+struct StartupTimer {
+    using Clock = std::chrono::steady_clock;
+    // record duration since the previous stage (or timer creation)
+    void stage(std::string_view name) {
+        Clock::time_point now = Clock::now();
+        stages.emplace_back(name, std::chrono::duration<float, std::milli>(now - last).count());
+        last = now;
+    }
+    void first_frame() {
+        if (bFirstFrame) return;
+        bFirstFrame = true;
+        stage("first_frame");
+        firstFrame = std::chrono::duration<float, std::milli>(last - start).count();
+        report();
+    }
+    void report() {
+        fmt::println("startup:");
+        for (const auto& [name, ms] : stages) fmt::println("\t{:<16} {:>8.2f} ms", name, ms);
+        fmt::println("\ttime to first frame: {:.2f} ms", firstFrame);
+        if (path.empty()) return;
+
+        // one key per line, parsed by vulkan-renderer-bench --startup
+        std::string json = "{\n  \"stages_ms\": {\n";
+        for (size_t i = 0; i < stages.size(); i++) {
+            json += fmt::format("    \"{}\": {:.4f}{}\n", stages[i].first, stages[i].second, i + 1 < stages.size() ? "," : "");
+        }
+        json += fmt::format("  }},\n  \"first_frame_ms\": {:.4f}\n}}\n", firstFrame);
+        std::ofstream(path) << json;
+    }
+
+    std::string path; // optional json report output
+    Clock::time_point start = Clock::now();
+    Clock::time_point last = start;
+    std::vector<std::pair<std::string, float>> stages;
+    float firstFrame = 0.0f; // ms from timer creation until first present
+    bool bFirstFrame = false;
+};
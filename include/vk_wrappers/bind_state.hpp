@@ -0,0 +1,51 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+//
+#include <algorithm>
+#include <array>
+#include <span>
+#include <vector>
+
+// pipelines and descriptor sets bound on one command buffer, redundant binds are skipped
+// reset() after begin() and after recording anything that binds outside of the tracker (e.g. imgui)
+struct BindState {
+    void reset() {
+        points = {};
+    }
+    void bind_pipeline(vk::raii::CommandBuffer& cmd, vk::PipelineBindPoint bindPoint, vk::Pipeline pipeline) {
+        Point& point = points[index(bindPoint)];
+        if (point.pipeline == pipeline) {
+            nSkipped++;
+            return;
+        }
+        cmd.bindPipeline(bindPoint, pipeline);
+        point.pipeline = pipeline;
+        nBinds++;
+    }
+    // sets are compared by layout handle, layouts from the layout cache are shared by all identical shaders
+    void bind_sets(vk::raii::CommandBuffer& cmd, vk::PipelineBindPoint bindPoint, vk::PipelineLayout layout, std::span<const vk::DescriptorSet> sets) {
+        if (sets.empty()) return;
+        Point& point = points[index(bindPoint)];
+        if (point.layout == layout && std::ranges::equal(point.sets, sets)) {
+            nSkipped++;
+            return;
+        }
+        cmd.bindDescriptorSets(bindPoint, layout, 0, sets, {});
+        point.layout = layout;
+        point.sets.assign(sets.begin(), sets.end());
+        nBinds++;
+    }
+
+    uint32_t nBinds = 0, nSkipped = 0; // totals since construction
+
+private:
+    struct Point {
+        vk::Pipeline pipeline;
+        vk::PipelineLayout layout;
+        std::vector<vk::DescriptorSet> sets;
+    };
+    static uint32_t index(vk::PipelineBindPoint bindPoint) {
+        return bindPoint == vk::PipelineBindPoint::eCompute ? 0 : 1;
+    }
+    std::array<Point, 2> points; // compute, graphics
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.hpp>
+
+struct Buffer {
+    Buffer() = default;
+    // host access flags (e.g. eHostAccessSequentialWrite | eMapped) lift the device local requirement
+    Buffer(vma::UniqueAllocator& alloc, vk::DeviceSize size, vk::BufferUsageFlags usage, vma::AllocationCreateFlags flags = {}): size(size) {
+        // create buffer
+        vk::BufferCreateInfo bufferInfo = vk::BufferCreateInfo()
+            .setSize(size)
+            .setUsage(usage);
+        vma::AllocationCreateInfo allocInfo = vma::AllocationCreateInfo()
+            .setFlags(flags)
+            .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+        if (!(flags & (vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eHostAccessRandom))) {
+            allocInfo.setRequiredFlags(vk::MemoryPropertyFlagBits::eDeviceLocal);
+        }
+        vma::AllocationInfo info;
+        std::tie(buffer, allocation) = alloc->createBufferUnique(bufferInfo, allocInfo, &info);
+        pMapped = info.pMappedData;
+    }
+
+    vma::UniqueBuffer buffer;
+    vma::UniqueAllocation allocation;
+    vk::DeviceSize size = 0;
+    void* pMapped = nullptr; // only set for persistently mapped buffers
+};
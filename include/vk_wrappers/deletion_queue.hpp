@@ -0,0 +1,24 @@
+#pragma once
+//
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// resources that submitted work may still use, destroyed once the gpu passed the timeline value they were retired with
+// any movable object can be retired: images, buffers, pipelines, descriptor pools, a whole renderer or swapchain
+struct DeletionQueue {
+    // values have to be non-decreasing, entries are freed in order
+    template<typename T> void push(T&& resource, uint64_t value) {
+        entries.emplace_back(value, std::make_shared<std::remove_cvref_t<T>>(std::forward<T>(resource)));
+    }
+    // destroys every entry up to the completed timeline value
+    void collect(uint64_t completed) {
+        while (!entries.empty() && entries.front().first <= completed) entries.pop_front();
+    }
+    size_t size() const { return entries.size(); }
+
+private:
+    std::deque<std::pair<uint64_t, std::shared_ptr<void>>> entries;
+};
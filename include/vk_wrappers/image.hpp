@@ -1,20 +1,23 @@
 #pragma once
 #include <vulkan/vulkan_raii.hpp>
 #include <vk_mem_alloc.hpp>
+//
+#include <algorithm>
+#include <bit>
 
 struct Image {
     Image() = default;
     Image(vk::raii::Device& device, vma::UniqueAllocator& alloc, 
             vk::Extent3D extent, vk::Format format, 
-            vk::ImageUsageFlags usage, vk::ImageAspectFlags aspects)
-                : extent(extent), format(format) {
+            vk::ImageUsageFlags usage, vk::ImageAspectFlags aspects, uint32_t mipLevels = 1)
+                : extent(extent), format(format), aspects(aspects), mipLevels(mipLevels) {
         // create image
         vk::ImageCreateInfo imageInfo = vk::ImageCreateInfo()
             .setSamples(vk::SampleCountFlagBits::e1)
             .setTiling(vk::ImageTiling::eOptimal)
             .setImageType(vk::ImageType::e2D)
             .setFormat(format).setExtent(extent)
-            .setMipLevels(1).setArrayLayers(1)
+            .setMipLevels(mipLevels).setArrayLayers(1)
             .setUsage(usage);
         vma::AllocationCreateInfo allocInfo = vma::AllocationCreateInfo()
             .setUsage(vma::MemoryUsage::eAutoPreferDevice)
@@ -31,6 +34,78 @@ struct Image {
         view = device.createImageView(viewInfo);
     }
 
+    // single level image with linear tiling in persistently mapped memory, written by the host in place
+    // starts out in ePreinitialized so the written texels survive the first transition, row pitch is given by layout
+    static Image linear(vk::raii::Device& device, vma::UniqueAllocator& alloc, vk::Extent3D extent, vk::Format format,
+            vk::ImageUsageFlags usage, vk::SubresourceLayout& layout) {
+        Image linear;
+        linear.extent = extent;
+        linear.format = format;
+        vk::ImageCreateInfo imageInfo = vk::ImageCreateInfo()
+            .setSamples(vk::SampleCountFlagBits::e1)
+            .setTiling(vk::ImageTiling::eLinear)
+            .setImageType(vk::ImageType::e2D)
+            .setFormat(format).setExtent(extent)
+            .setMipLevels(1).setArrayLayers(1)
+            .setUsage(usage)
+            .setInitialLayout(vk::ImageLayout::ePreinitialized);
+        vma::AllocationCreateInfo allocInfo = vma::AllocationCreateInfo()
+            .setFlags(vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped)
+            .setUsage(vma::MemoryUsage::eAutoPreferDevice);
+        vma::AllocationInfo info;
+        std::tie(linear.image, linear.allocation) = alloc->createImageUnique(imageInfo, allocInfo, &info);
+        linear.pMapped = info.pMappedData;
+        linear.lastKnownLayout = vk::ImageLayout::ePreinitialized;
+        layout = device.getImageSubresourceLayout(*linear.image, vk::ImageSubresource(linear.aspects, 0, 0));
+
+        vk::ImageViewCreateInfo viewInfo = vk::ImageViewCreateInfo()
+            .setViewType(vk::ImageViewType::e2D)
+            .setImage(*linear.image).setFormat(format)
+            .setSubresourceRange(vk::ImageSubresourceRange(linear.aspects, 0, 1, 0, 1));
+        linear.view = device.createImageView(viewInfo);
+        return linear;
+    }
+
+    // number of levels in a full mip chain down to 1x1
+    static uint32_t mip_count(vk::Extent3D extent) {
+        return std::bit_width(std::max({ extent.width, extent.height, extent.depth }));
+    }
+    // fills all levels from level 0 with successive blits, every level has to be in eTransferDstOptimal
+    // afterwards all levels are in eTransferSrcOptimal
+    void generate_mips(vk::raii::CommandBuffer& cmd, vk::Filter filter) {
+        vk::ImageMemoryBarrier2 levelBarrier = vk::ImageMemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eAllTransfer)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eAllTransfer)
+            .setDstAccessMask(vk::AccessFlagBits2::eTransferRead)
+            .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+            .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+            .setImage(*image);
+        vk::DependencyInfo depInfo = vk::DependencyInfo()
+            .setImageMemoryBarriers(levelBarrier);
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            // previous blit (or upload) has to finish writing before the level becomes the next source
+            levelBarrier.setSubresourceRange(vk::ImageSubresourceRange(aspects, level, 1, 0, vk::RemainingArrayLayers));
+            cmd.pipelineBarrier2(depInfo);
+            if (level + 1 == mipLevels) break;
+
+            vk::Offset3D srcSize = vk::Offset3D(std::max(extent.width >> level, 1u), std::max(extent.height >> level, 1u), std::max(extent.depth >> level, 1u));
+            vk::Offset3D dstSize = vk::Offset3D(std::max(srcSize.x / 2, 1), std::max(srcSize.y / 2, 1), std::max(srcSize.z / 2, 1));
+            vk::ImageBlit2 blitRegion = vk::ImageBlit2()
+                .setSrcSubresource(vk::ImageSubresourceLayers(aspects, level, 0, 1))
+                .setSrcOffsets({ vk::Offset3D(), srcSize })
+                .setDstSubresource(vk::ImageSubresourceLayers(aspects, level + 1, 0, 1))
+                .setDstOffsets({ vk::Offset3D(), dstSize });
+            vk::BlitImageInfo2 blitInfo = vk::BlitImageInfo2()
+                .setSrcImage(*image).setSrcImageLayout(vk::ImageLayout::eTransferSrcOptimal)
+                .setDstImage(*image).setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
+                .setRegions(blitRegion)
+                .setFilter(filter);
+            cmd.blitImage2(blitInfo);
+        }
+        lastKnownLayout = vk::ImageLayout::eTransferSrcOptimal;
+    }
+
     using StageFlags = vk::PipelineStageFlags2;
     void transition_layout(vk::raii::CommandBuffer& cmd, vk::ImageLayout layoutNew, 
             vk::PipelineStageFlags2 srcStage, vk::PipelineStageFlags2 dstStage,
@@ -91,5 +166,7 @@ struct Image {
     vk::Extent3D extent;
     vk::Format format;
     vk::ImageAspectFlags aspects = vk::ImageAspectFlagBits::eColor;
+    uint32_t mipLevels = 1;
     vk::ImageLayout lastKnownLayout = vk::ImageLayout::eUndefined;
+    void* pMapped = nullptr; // only set for linear images
 };
@@ -3,10 +3,15 @@
 #include <SDL3/SDL_events.h>
 #include <imgui.h>
 //
+#include "postprocess.hpp"
 #include "vk_wrappers/queues.hpp"
 #include "vk_wrappers/image.hpp"
 
 namespace ImGui {
+    namespace backend {
+        inline float maxUpdateRate = 60.0f; // cap for ui updates per second, 0 to disable
+        float get_frame_time(); // render loop frame time, independent of ui update rate
+    }
     namespace frontend {
         static void display_fps() {
             ImGui::SetNextWindowBgAlpha(0.35f);
@@ -18,17 +23,35 @@ namespace ImGui {
                 | ImGuiWindowFlags_NoNav
                 | ImGuiWindowFlags_NoMove
                 | ImGuiWindowFlags_NoMouseInputs);
-            ImGui::Text("%.1f fps", ImGui::GetIO().Framerate);
-            ImGui::Text("%.1f ms", ImGui::GetIO().DeltaTime * 1000.0f);
+            ImGui::Text("%.1f fps", 1.0f / backend::get_frame_time());
+            ImGui::Text("%.1f ms", backend::get_frame_time() * 1000.0f);
+            ImGui::End();
+        }
+        static void display_postprocess(PostProcess& postProcess) {
+            ImGui::Begin("Post Processing", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+            for (uint32_t i = 0; i < postProcess.passes.size(); i++) {
+                PostProcess::Pass& pass = postProcess.passes[i];
+                ImGui::Checkbox(pass.name.c_str(), &pass.bEnabled);
+                ImGui::SameLine(160.0f);
+                if (pass.bActive) ImGui::Text("%.3f ms", pass.time);
+                else ImGui::TextDisabled("inactive");
+            }
+            ImGui::SeparatorText("Bloom");
+            ImGui::SliderFloat("threshold", &postProcess.bloomParams.threshold, 0.0f, 4.0f);
+            ImGui::SliderFloat("knee", &postProcess.bloomParams.knee, 0.0f, 1.0f);
+            ImGui::SliderFloat("intensity", &postProcess.bloomParams.intensity, 0.0f, 2.0f);
             ImGui::End();
         }
     }
     namespace backend {
         void init_sdl(SDL_Window* pWindow);
-        void init_vulkan(vk::raii::Instance& instance, vk::raii::Device& device, vk::raii::PhysicalDevice& physDevice, Queues& queues, vk::Format swapchainFormat);
+        void init_vulkan(vk::raii::Instance& instance, vk::raii::Device& device, vk::raii::PhysicalDevice& physDevice, Queues& queues, vk::Format colorFormat);
+        void upload_fonts();
         bool process_event(SDL_Event* pEvent);
-        void new_frame();
-        void draw(vk::raii::CommandBuffer& cmd, vk::raii::ImageView& imageView, vk::ImageLayout layout, vk::Extent2D extent);
+        bool new_frame(); // returns false if the ui update was skipped due to the rate cap
+        bool new_frame(bool bUpdate); // update (or skip) regardless of the rate cap, e.g. to follow an input replay
+        bool render(); // returns true if the draw data changed since the last render
+        void draw(vk::raii::CommandBuffer& cmd, vk::raii::ImageView& imageView, vk::ImageLayout layout, vk::Extent2D extent, bool bClear = false);
         void shutdown();
     }
 }
\ No newline at end of file
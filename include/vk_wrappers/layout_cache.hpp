@@ -0,0 +1,15 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+//
+#include <memory>
+#include <span>
+
+// identical descriptor set and pipeline layouts are shared between shaders, which keeps bound sets compatible across pipelines
+// entries are destroyed together with their last user, the cache only holds weak references
+namespace LayoutCache {
+    using SetLayout = std::shared_ptr<vk::raii::DescriptorSetLayout>;
+    using PipelineLayout = std::shared_ptr<vk::raii::PipelineLayout>;
+
+    SetLayout get_set_layout(vk::raii::Device& device, std::span<const vk::DescriptorSetLayoutBinding> bindings);
+    PipelineLayout get_pipeline_layout(vk::raii::Device& device, std::span<const SetLayout> setLayouts, std::span<const vk::PushConstantRange> pushRanges);
+}
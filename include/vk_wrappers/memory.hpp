@@ -0,0 +1,25 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+
+namespace Memory {
+    // unified memory architecture: the gpu shares system memory (integrated gpus, software icds)
+    // staging copies only cost bandwidth there, resources can be written in place
+    // drivers may still expose device local types without host access (amd apus do), so only the largest
+    // device local heap is required to have a host visible type
+    inline bool is_unified(vk::raii::PhysicalDevice& physDevice) {
+        vk::PhysicalDeviceType type = physDevice.getProperties().deviceType;
+        if (type != vk::PhysicalDeviceType::eIntegratedGpu && type != vk::PhysicalDeviceType::eCpu) return false;
+        vk::PhysicalDeviceMemoryProperties props = physDevice.getMemoryProperties();
+        uint32_t heap = UINT32_MAX;
+        for (uint32_t i = 0; i < props.memoryHeapCount; i++) {
+            if (!(props.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal)) continue;
+            if (heap == UINT32_MAX || props.memoryHeaps[i].size > props.memoryHeaps[heap].size) heap = i;
+        }
+        for (uint32_t i = 0; i < props.memoryTypeCount; i++) {
+            vk::MemoryPropertyFlags flags = props.memoryTypes[i].propertyFlags;
+            vk::MemoryPropertyFlags unified = vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eHostVisible;
+            if (props.memoryTypes[i].heapIndex == heap && (flags & unified) == unified) return true;
+        }
+        return false;
+    }
+}
@@ -1,20 +1,49 @@
 #pragma once
+#include <fmt/base.h>
+//
+#include <array>
+#include <span>
 #include <string_view>
+#include <type_traits>
+#include <vector>
 //
+#include "vk_wrappers/bind_state.hpp"
+#include "vk_wrappers/layout_cache.hpp"
 #include "vk_wrappers/shader.hpp"
 
 namespace Pipelines {
+	// push constants are written for every stage whose reflected range overlaps the written bytes
+	template<typename T> void write_push_constants(vk::raii::CommandBuffer& cmd, vk::PipelineLayout layout, std::span<const vk::PushConstantRange> ranges,
+			std::string_view path, const T& data, uint32_t offset) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		uint32_t end = offset + sizeof(T);
+		vk::ShaderStageFlags stages;
+		for (const auto& range : ranges) {
+			if (range.offset >= end || range.offset + range.size <= offset) continue;
+			if (range.offset > offset || range.offset + range.size < end) {
+				fmt::println("{}: push constants [{}, {}) exceed the reflected range [{}, {})", path, offset, end, range.offset, range.offset + range.size);
+				return;
+			}
+			stages |= range.stageFlags;
+		}
+		if (!stages) {
+			fmt::println("{}: no push constant range at offset {}", path, offset);
+			return;
+		}
+		cmd.pushConstants<T>(layout, stages, offset, data);
+	}
+
 	struct Compute {
 		Compute(std::string_view path_cs): cs(std::string(path_cs).append(".spv")) {}
-		void init(vk::raii::Device& device) {
-			cs.init(device);
+		void reflect() {
+			cs.reflect();
+		}
+		void init(vk::raii::Device& device, uint32_t nInstances = 1) {
+			cs.init(device, nInstances);
 			vk::raii::ShaderModule csModule = cs.compile(device);
 
-			// create layouts
-			std::vector<vk::DescriptorSetLayout> layouts;
-			for (const auto& set : cs.descSetLayouts) layouts.emplace_back(*set);
-			vk::PipelineLayoutCreateInfo layoutInfo = vk::PipelineLayoutCreateInfo({}, layouts);
-			layout = device.createPipelineLayout(layoutInfo);
+			// shared layout from descriptor sets and push constants
+			layout = LayoutCache::get_pipeline_layout(device, cs.descSetLayouts, cs.pushRanges);
 
 			// create pipeline
 			vk::PipelineShaderStageCreateInfo stageInfo = vk::PipelineShaderStageCreateInfo()
@@ -22,22 +51,126 @@ namespace Pipelines {
 				.setStage(vk::ShaderStageFlagBits::eCompute)
 				.setPName("main");
 			vk::ComputePipelineCreateInfo pipeInfo = vk::ComputePipelineCreateInfo()
-				.setLayout(*layout)
+				.setLayout(**layout)
 				.setStage(stageInfo);
 			pipeline = device.createComputePipeline(nullptr, pipeInfo);
 		}
-		void execute(vk::raii::CommandBuffer& cmd, uint32_t x, uint32_t y, uint32_t z) {
-			cmd.bindPipeline(vk::PipelineBindPoint::eCompute, *pipeline);
-			cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, *layout, 0, cs.descSets, {});
+		// bindings already present on the command buffer are skipped
+		void execute(vk::raii::CommandBuffer& cmd, BindState& state, uint32_t x, uint32_t y, uint32_t z, uint32_t instance = 0) {
+			uint32_t nSets = cs.descSetLayouts.size();
+			state.bind_pipeline(cmd, vk::PipelineBindPoint::eCompute, *pipeline);
+			state.bind_sets(cmd, vk::PipelineBindPoint::eCompute, **layout, std::span(cs.descSets).subspan(instance * nSets, nSets));
 			cmd.dispatch(x, y, z);
 		}
+		// record before execute(), T has to match the shader's push constant block
+		template<typename T> void push_constants(vk::raii::CommandBuffer& cmd, const T& data, uint32_t offset = 0) {
+			write_push_constants(cmd, **layout, cs.pushRanges, cs.path, data, offset);
+		}
 
 		Shader cs;
 		vk::raii::Pipeline pipeline = nullptr;
-		vk::raii::PipelineLayout layout = nullptr;
+		LayoutCache::PipelineLayout layout;
 	};
 	struct Graphics {
 		Graphics(std::string_view path_vs, std::string_view path_fs): vs(std::string(path_vs).append(".spv")), fs(std::string(path_fs).append(".spv")) {}
+		void reflect() {
+			vs.reflect();
+			fs.reflect();
+		}
+		// descriptor sets of both stages are merged into vs, write descriptors through it
+		void init(vk::raii::Device& device, vk::ArrayProxy<const vk::Format> colorFormats, vk::Format depthFormat = vk::Format::eUndefined, uint32_t nInstances = 1) {
+			if (!vs.bReflected) vs.reflect();
+			if (!fs.bReflected) fs.reflect();
+			if (fs.nColorOutputs != colorFormats.size()) fmt::println("{}: {} color output(s) but {} attachment format(s)", fs.path, fs.nColorOutputs, colorFormats.size());
+			vs.merge(fs);
+			vs.init(device, nInstances);
+			vk::raii::ShaderModule vsModule = vs.compile(device);
+			vk::raii::ShaderModule fsModule = fs.compile(device);
+			bDepth = depthFormat != vk::Format::eUndefined;
+
+			// shared layout from descriptor sets and push constants of both stages
+			layout = LayoutCache::get_pipeline_layout(device, vs.descSetLayouts, vs.pushRanges);
+
+			// shader stages
+			std::array<vk::PipelineShaderStageCreateInfo, 2> stageInfos = {
+				vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, *vsModule, "main"),
+				vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, *fsModule, "main"),
+			};
+			// reflected vertex layout, one interleaved per-vertex binding
+			vk::VertexInputBindingDescription vertexBinding(0, vs.vertexStride, vk::VertexInputRate::eVertex);
+			vk::PipelineVertexInputStateCreateInfo vertexInfo = vk::PipelineVertexInputStateCreateInfo()
+				.setVertexAttributeDescriptions(vs.vertexAttributes);
+			if (vs.vertexStride > 0) vertexInfo.setVertexBindingDescriptions(vertexBinding);
+			vk::PipelineInputAssemblyStateCreateInfo assemblyInfo = vk::PipelineInputAssemblyStateCreateInfo()
+				.setTopology(vk::PrimitiveTopology::eTriangleList);
+			// viewport, scissor, culling and depth test are set dynamically in bind()
+			vk::PipelineViewportStateCreateInfo viewportInfo = vk::PipelineViewportStateCreateInfo()
+				.setViewportCount(1)
+				.setScissorCount(1);
+			vk::PipelineRasterizationStateCreateInfo rasterInfo = vk::PipelineRasterizationStateCreateInfo()
+				.setPolygonMode(vk::PolygonMode::eFill)
+				.setLineWidth(1.0f);
+			vk::PipelineMultisampleStateCreateInfo multisampleInfo = vk::PipelineMultisampleStateCreateInfo()
+				.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+			vk::PipelineDepthStencilStateCreateInfo depthInfo = vk::PipelineDepthStencilStateCreateInfo();
+			vk::PipelineColorBlendAttachmentState blendAttachment = vk::PipelineColorBlendAttachmentState()
+				.setColorWriteMask(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+			if (bBlend) {
+				blendAttachment.setBlendEnable(vk::True)
+					.setSrcColorBlendFactor(vk::BlendFactor::eOne).setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha).setColorBlendOp(vk::BlendOp::eAdd)
+					.setSrcAlphaBlendFactor(vk::BlendFactor::eOne).setDstAlphaBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha).setAlphaBlendOp(vk::BlendOp::eAdd);
+			}
+			std::vector<vk::PipelineColorBlendAttachmentState> blendAttachments(colorFormats.size(), blendAttachment);
+			vk::PipelineColorBlendStateCreateInfo blendInfo = vk::PipelineColorBlendStateCreateInfo()
+				.setAttachments(blendAttachments);
+			std::array<vk::DynamicState, 7> dynamicStates = {
+				vk::DynamicState::eViewport, vk::DynamicState::eScissor,
+				vk::DynamicState::eCullMode, vk::DynamicState::eFrontFace,
+				vk::DynamicState::eDepthTestEnable, vk::DynamicState::eDepthWriteEnable, vk::DynamicState::eDepthCompareOp,
+			};
+			vk::PipelineDynamicStateCreateInfo dynamicInfo = vk::PipelineDynamicStateCreateInfo()
+				.setDynamicStates(dynamicStates);
+
+			// create pipeline for dynamic rendering
+			vk::PipelineRenderingCreateInfo renderingInfo = vk::PipelineRenderingCreateInfo()
+				.setColorAttachmentFormats(colorFormats)
+				.setDepthAttachmentFormat(depthFormat);
+			vk::GraphicsPipelineCreateInfo pipeInfo = vk::GraphicsPipelineCreateInfo()
+				.setPNext(&renderingInfo)
+				.setStages(stageInfos)
+				.setPVertexInputState(&vertexInfo)
+				.setPInputAssemblyState(&assemblyInfo)
+				.setPViewportState(&viewportInfo)
+				.setPRasterizationState(&rasterInfo)
+				.setPMultisampleState(&multisampleInfo)
+				.setPDepthStencilState(&depthInfo)
+				.setPColorBlendState(&blendInfo)
+				.setPDynamicState(&dynamicInfo)
+				.setLayout(**layout);
+			pipeline = device.createGraphicsPipeline(nullptr, pipeInfo);
+		}
+		// bind pipeline and descriptor sets, then reset dynamic state to defaults for the given render area
+		void bind(vk::raii::CommandBuffer& cmd, BindState& state, vk::Extent2D extent, uint32_t instance = 0) {
+			uint32_t nSets = vs.descSetLayouts.size();
+			state.bind_pipeline(cmd, vk::PipelineBindPoint::eGraphics, *pipeline);
+			state.bind_sets(cmd, vk::PipelineBindPoint::eGraphics, **layout, std::span(vs.descSets).subspan(instance * nSets, nSets));
+			cmd.setViewport(0, vk::Viewport(0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f));
+			cmd.setScissor(0, vk::Rect2D({ 0, 0 }, extent));
+			cmd.setCullMode(vk::CullModeFlagBits::eBack);
+			cmd.setFrontFace(vk::FrontFace::eCounterClockwise);
+			cmd.setDepthTestEnable(bDepth);
+			cmd.setDepthWriteEnable(bDepth);
+			cmd.setDepthCompareOp(vk::CompareOp::eLess);
+		}
+		// push constants of both stages, merged into vs
+		template<typename T> void push_constants(vk::raii::CommandBuffer& cmd, const T& data, uint32_t offset = 0) {
+			write_push_constants(cmd, **layout, vs.pushRanges, vs.path, data, offset);
+		}
+
 		Shader vs, fs;
+		vk::raii::Pipeline pipeline = nullptr;
+		LayoutCache::PipelineLayout layout;
+		bool bDepth = false;
+		bool bBlend = false; // premultiplied alpha blending onto the color attachments, set before init()
 	};
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #include <vulkan/vulkan_raii.hpp>
 //
 #include <functional>
+//
+#include "vk_wrappers/deletion_queue.hpp"
 
 // forward declare
 namespace vkb { struct Device; }
@@ -13,7 +15,9 @@ struct Queue {
     // oneshot command objects
     vk::raii::CommandPool cmdPool = nullptr;
     vk::raii::CommandBuffer cmd = nullptr; // buffer for immediate submissions
-    vk::raii::Semaphore timeline = nullptr; // gpu->cpu sync
+    vk::raii::Semaphore timeline = nullptr; // gpu->cpu sync, signaled with ++timelineValue by every submission to the queue
+    uint64_t timelineValue = 0; // owned by the thread submitting to the queue, not synchronized
+    DeletionQueue retired;
 
     void init(vk::raii::Device& device) {
         vk::CommandPoolCreateInfo poolInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, index);
@@ -25,7 +29,24 @@ struct Queue {
         vk::SemaphoreCreateInfo semaInfo = vk::SemaphoreCreateInfo({}, &typeInfo);
         timeline = device.createSemaphore(semaInfo);
     }
-
+    // submits a recorded command buffer signaling ++timelineValue, returns the value to wait for or co_await
+    uint64_t submit(vk::raii::CommandBuffer& commandBuffer) {
+        vk::TimelineSemaphoreSubmitInfo timelineInfo({}, ++timelineValue);
+        vk::SubmitInfo submitInfo = vk::SubmitInfo()
+            .setPNext(&timelineInfo)
+            .setSignalSemaphores(*timeline)
+            .setCommandBuffers(*commandBuffer);
+        queue.submit(submitInfo);
+        return timelineValue;
+    }
+    // resource used by the submissions so far or the next one, destroyed by collect() once the next value is reached
+    template<typename T> void retire(T&& resource) {
+        retired.push(std::forward<T>(resource), timelineValue + 1);
+    }
+    // destroys retired resources the gpu is done with, never waits
+    void collect() {
+        retired.collect(timeline.getCounterValue());
+    }
 };
 struct Queues {
     void init(vk::raii::Device& device, vkb::Device& deviceVkb);
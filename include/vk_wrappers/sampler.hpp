@@ -0,0 +1,54 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+//
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+// samplers are deduplicated by their create info, devices only allow a limited number of them (maxSamplerAllocationCount)
+struct SamplerCache {
+    SamplerCache() = default;
+    // moving is only valid while no other thread uses the cache
+    SamplerCache(SamplerCache&& other) noexcept : samplers(std::move(other.samplers)) {}
+    SamplerCache& operator=(SamplerCache&& other) noexcept {
+        samplers = std::move(other.samplers);
+        return *this;
+    }
+
+    // the create info must not have a pNext chain, returned samplers live as long as the cache
+    vk::Sampler get(vk::raii::Device& device, const vk::SamplerCreateInfo& info) {
+        std::lock_guard lock(mutex);
+        auto it = samplers.find(info);
+        if (it == samplers.end()) it = samplers.emplace(info, device.createSampler(info)).first;
+        return *it->second;
+    }
+    size_t size() const { return samplers.size(); }
+
+private:
+    struct Hash {
+        size_t operator()(const vk::SamplerCreateInfo& info) const {
+            size_t hash = 0;
+            auto combine = [&hash](auto value) {
+                hash ^= std::hash<decltype(value)>()(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            };
+            combine((uint32_t)info.magFilter);
+            combine((uint32_t)info.minFilter);
+            combine((uint32_t)info.mipmapMode);
+            combine((uint32_t)info.addressModeU);
+            combine((uint32_t)info.addressModeV);
+            combine((uint32_t)info.addressModeW);
+            combine(info.mipLodBias);
+            combine(info.anisotropyEnable);
+            combine(info.maxAnisotropy);
+            combine(info.compareEnable);
+            combine((uint32_t)info.compareOp);
+            combine(info.minLod);
+            combine(info.maxLod);
+            combine((uint32_t)info.borderColor);
+            combine(info.unnormalizedCoordinates);
+            return hash;
+        }
+    };
+    std::mutex mutex;
+    std::unordered_map<vk::SamplerCreateInfo, vk::raii::Sampler, Hash> samplers;
+};
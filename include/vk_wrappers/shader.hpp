@@ -4,29 +4,74 @@
 #include <string_view>
 //
 #include "vk_wrappers/image.hpp"
+#include "vk_wrappers/buffer.hpp"
+#include "vk_wrappers/layout_cache.hpp"
 
 struct Shader {
 	Shader(std::string_view path);
-    void init(vk::raii::Device& device);
+    void reflect(); // device independent, may run ahead of init()
+    void merge(const Shader& other); // combine descriptor bindings of another stage before init()
+    void init(vk::raii::Device& device, uint32_t nInstances = 1);
+    // fresh pool and sets for rewriting descriptors that in-flight frames may still bind, returns the old pool to retire
+    vk::raii::DescriptorPool reallocate(vk::raii::Device& device, uint32_t nInstances = 1);
     vk::raii::ShaderModule compile(vk::raii::Device& device);
 
     // todo: different layout/type based on shader stage
-	void write_descriptor(Image& image, uint32_t set, uint32_t binding) {
+	void write_descriptor(Image& image, uint32_t set, uint32_t binding, uint32_t instance = 0) {
+        write_descriptor(*image.view, set, binding, instance);
+	}
+	void write_descriptor(vk::ImageView imageView, uint32_t set, uint32_t binding, uint32_t instance = 0) {
         vk::DescriptorImageInfo imageInfo = vk::DescriptorImageInfo()
             .setImageLayout(vk::ImageLayout::eGeneral)
-            .setImageView(*image.view);
+            .setImageView(imageView);
         vk::WriteDescriptorSet drawImageWrite = vk::WriteDescriptorSet()
             .setDstBinding(binding)
-            .setDstSet(descSets[set])
+            .setDstSet(descSets[instance * descSetLayouts.size() + set])
             .setDescriptorCount(1)
             .setDescriptorType(vk::DescriptorType::eStorageImage)
             .setImageInfo(imageInfo);
         pool.getDevice().updateDescriptorSets(drawImageWrite, {});
 	}
+	void write_descriptor(vk::ImageView imageView, vk::Sampler sampler, uint32_t set, uint32_t binding, uint32_t instance = 0, vk::ImageLayout layout = vk::ImageLayout::eReadOnlyOptimal) {
+        vk::DescriptorImageInfo imageInfo = vk::DescriptorImageInfo()
+            .setImageLayout(layout)
+            .setImageView(imageView)
+            .setSampler(sampler);
+        vk::WriteDescriptorSet samplerWrite = vk::WriteDescriptorSet()
+            .setDstBinding(binding)
+            .setDstSet(descSets[instance * descSetLayouts.size() + set])
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setImageInfo(imageInfo);
+        pool.getDevice().updateDescriptorSets(samplerWrite, {});
+	}
+	void write_descriptor(Buffer& buffer, uint32_t set, uint32_t binding, uint32_t instance = 0) {
+        vk::DescriptorBufferInfo bufferInfo = vk::DescriptorBufferInfo()
+            .setBuffer(*buffer.buffer)
+            .setOffset(0)
+            .setRange(buffer.size);
+        vk::WriteDescriptorSet bufferWrite = vk::WriteDescriptorSet()
+            .setDstBinding(binding)
+            .setDstSet(descSets[instance * descSetLayouts.size() + set])
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setBufferInfo(bufferInfo);
+        pool.getDevice().updateDescriptorSets(bufferWrite, {});
+	}
 
 	std::string path;
 	vk::ShaderStageFlags stage;
+	std::vector<std::vector<vk::DescriptorSetLayoutBinding>> setBindings;
+	std::vector<vk::DescriptorPoolSize> poolSizes;
+	std::vector<vk::PushConstantRange> pushRanges; // one per push constant block
+	std::vector<vk::VertexInputAttributeDescription> vertexAttributes; // vertex stage inputs, tightly packed in binding 0
+	uint32_t vertexStride = 0;
+	uint32_t nColorOutputs = 0; // fragment stage outputs
+	bool bReflected = false;
 	vk::raii::DescriptorPool pool = nullptr;
-	std::vector<vk::DescriptorSet> descSets;
-    std::vector<vk::raii::DescriptorSetLayout> descSetLayouts;
+	std::vector<vk::DescriptorSet> descSets; // all sets of instance 0, followed by instance 1, ...
+    std::vector<LayoutCache::SetLayout> descSetLayouts; // shared with identical sets of other shaders
+
+private:
+    void allocate_sets(vk::raii::Device& device, uint32_t nInstances);
 };
\ No newline at end of file
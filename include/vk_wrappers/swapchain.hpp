@@ -1,13 +1,20 @@
 #pragma once
 #include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.hpp>
+//
+#include <memory>
+//
+#include "vk_wrappers/pipeline.hpp"
 
 // forward declare
 struct Window;
 struct Image;
+struct Queue;
 struct Queues;
 
 struct Swapchain {
-    void init(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, Window& window, Queues& queues);
+    // a replaced swapchain is passed as oldSwapchain and kept until this one presented once, see pOldSwapchain
+    void init(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc, Window& window, Queues& queues, std::unique_ptr<Swapchain> oldSwapchain = {});
     void present(vk::raii::Device& device, Image& image, vk::raii::Semaphore& imageSema, uint64_t& semaValue);
 
     vk::raii::SwapchainKHR swapchain = nullptr;
@@ -16,9 +23,20 @@ struct Swapchain {
     vk::Extent2D extent;
     vk::Format format;
     vk::Queue presentationQueue;
+    Queue* pQueue = nullptr; // queue of presentationQueue, its timeline is signaled by every present
     bool bResizeRequested = true;
+    bool bStoragePreferred = true; // write directly into swapchain images via compute when supported
+    bool bStorage = false; // whether the compute present path is active
+    Image overlay; // cached ui layer, composited by the compute present path or drawn over the blit
+    // without VK_EXT_swapchain_maintenance1 nothing signals when a present consumed its wait semaphores,
+    // the replaced swapchain (and its present semaphores) is only retired after the first present of this one
+    std::unique_ptr<Swapchain> pOldSwapchain;
 
 private:
+    void blit(vk::raii::CommandBuffer& cmd, Image& image, uint32_t index);
+    void draw_overlay(vk::raii::CommandBuffer& cmd, vk::PipelineStageFlags2 readStage);
+    void convert(vk::raii::CommandBuffer& cmd, Image& image, uint32_t index);
+
     struct FrameData {
         // command recording
         vk::raii::CommandPool commandPool = nullptr;
@@ -30,4 +48,10 @@ private:
     };
     std::vector<FrameData> frames;
     uint32_t iSyncFrame = 0;
+    // compute present path, one descriptor instance per swapchain image
+    Pipelines::Compute presentPipe = Pipelines::Compute("present.comp");
+    vk::ImageView presentSource = nullptr;
+    // blit present path, draws the overlay over the blitted image
+    Pipelines::Graphics overlayPipe = Pipelines::Graphics("overlay.vert", "overlay.frag");
+    bool bOverlayDirty = true;
 };
\ No newline at end of file
@@ -0,0 +1,173 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+//
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <vector>
+//
+#include "vk_wrappers/queues.hpp"
+
+// coroutines that suspend on queue timeline values instead of blocking a thread
+// the scheduler resumes them from the main loop once the gpu reached the awaited value, e.g.
+//
+//     Tasks::Task readback(Queue& queue, ...) {
+//         record_upload(queue.cmd, ...);
+//         co_await Tasks::timeline(queue, queue.submit(queue.cmd));
+//         record_process(queue.cmd, ...);
+//         co_await Tasks::timeline(queue, queue.submit(queue.cmd));
+//         read_results(...);
+//     }
+//     tasks.spawn(readback(queues.graphics, ...));
+namespace Tasks {
+    struct Scheduler;
+
+    // lazily started coroutine, either spawned on a scheduler or awaited by another task
+    struct Task {
+        struct promise_type {
+            Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            // continues the awaiting task, if any
+            auto final_suspend() noexcept {
+                struct Continuation {
+                    bool await_ready() noexcept { return false; }
+                    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                        std::coroutine_handle<> continuation = handle.promise().continuation;
+                        return continuation ? continuation : std::noop_coroutine();
+                    }
+                    void await_resume() noexcept {}
+                };
+                return Continuation();
+            }
+            void return_void() {}
+            void unhandled_exception() { exception = std::current_exception(); }
+
+            Scheduler* pScheduler = nullptr;
+            std::coroutine_handle<> continuation;
+            std::exception_ptr exception;
+        };
+
+        Task() = default;
+        explicit Task(std::coroutine_handle<promise_type> handle): handle(handle) {}
+        Task(Task&& other) noexcept: handle(std::exchange(other.handle, nullptr)) {}
+        Task& operator=(Task&& other) noexcept {
+            if (this != &other) {
+                destroy();
+                handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+        ~Task() { destroy(); }
+
+        bool done() const { return !handle || handle.done(); }
+        // awaiting a task runs it until its first suspension, the awaiting task continues once it finished
+        bool await_ready() const noexcept { return done(); }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> awaiting) noexcept {
+            handle.promise().pScheduler = awaiting.promise().pScheduler;
+            handle.promise().continuation = awaiting;
+            return handle;
+        }
+        // exceptions propagate to the awaiting task
+        void await_resume() {
+            if (handle && handle.promise().exception) std::rethrow_exception(handle.promise().exception);
+        }
+
+        std::coroutine_handle<promise_type> handle;
+
+    private:
+        void destroy() {
+            if (handle) handle.destroy();
+            handle = nullptr;
+        }
+    };
+
+    // suspends until the queue's timeline reached the value, completes immediately if it already did
+    struct TimelineAwaiter {
+        bool await_ready() { return pQueue->timeline.getCounterValue() >= value; }
+        void await_suspend(std::coroutine_handle<Task::promise_type> handle);
+        void await_resume() {}
+
+        Queue* pQueue;
+        uint64_t value;
+    };
+    inline TimelineAwaiter timeline(Queue& queue, uint64_t value) {
+        return TimelineAwaiter(&queue, value);
+    }
+
+    // owns spawned tasks and resumes the suspended ones, all on the thread calling poll() or wait()
+    // exceptions a spawned task does not handle are rethrown from spawn() or poll()
+    // tasks may only submit to queues owned by that thread: Queue::submit() and timelineValue are not synchronized,
+    // and the engine's queues belong to its render thread (transfer and compute may alias the graphics vk::Queue)
+    struct Scheduler {
+        Scheduler() = default;
+        Scheduler(const Scheduler&) = delete; // promises point back to their scheduler
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        // runs the task until its first suspension
+        void spawn(Task task) {
+            if (task.done()) return;
+            task.handle.promise().pScheduler = this;
+            std::coroutine_handle<> handle = task.handle;
+            tasks.push_back(std::move(task));
+            handle.resume();
+            collect();
+        }
+        // resumes every task whose timeline value was reached, never waits
+        void poll() {
+            std::vector<Waiting> ready;
+            std::erase_if(waiting, [&](const Waiting& entry) {
+                if (entry.pQueue->timeline.getCounterValue() < entry.value) return false;
+                ready.push_back(entry);
+                return true;
+            });
+            // resumed tasks may suspend again, which only appends to waiting
+            for (Waiting& entry : ready) entry.handle.resume();
+            collect();
+        }
+        // blocks until any awaited value was reached (or the timeout passed), then polls
+        // a scheduler on another thread needs its own queues, see above
+        void wait(vk::raii::Device& device, uint64_t timeout = UINT64_MAX) {
+            if (waiting.empty()) return;
+            std::vector<vk::Semaphore> semaphores;
+            std::vector<uint64_t> values;
+            for (Waiting& entry : waiting) {
+                semaphores.push_back(*entry.pQueue->timeline);
+                values.push_back(entry.value);
+            }
+            vk::SemaphoreWaitInfo waitInfo(vk::SemaphoreWaitFlagBits::eAny, semaphores, values);
+            if (device.waitSemaphores(waitInfo, timeout) == vk::Result::eSuccess) poll();
+        }
+        // destroys all tasks without resuming them, their resources have to be idle
+        void clear() {
+            waiting.clear();
+            tasks.clear();
+        }
+        size_t size() const { return tasks.size(); }
+
+    private:
+        friend TimelineAwaiter;
+        struct Waiting {
+            Queue* pQueue;
+            uint64_t value;
+            std::coroutine_handle<> handle;
+        };
+        // destroys finished tasks, rethrowing what they did not handle
+        void collect() {
+            std::exception_ptr exception;
+            std::erase_if(tasks, [&](Task& task) {
+                if (!task.done()) return false;
+                if (task.handle.promise().exception) exception = task.handle.promise().exception;
+                return true;
+            });
+            if (exception) std::rethrow_exception(exception);
+        }
+
+        std::vector<Task> tasks;
+        std::vector<Waiting> waiting;
+    };
+
+    inline void TimelineAwaiter::await_suspend(std::coroutine_handle<Task::promise_type> handle) {
+        handle.promise().pScheduler->waiting.emplace_back(pQueue, value, handle);
+    }
+}
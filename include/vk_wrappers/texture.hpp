@@ -0,0 +1,59 @@
+#pragma once
+#include <vulkan/vulkan_raii.hpp>
+#include <vk_mem_alloc.hpp>
+//
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+//
+#include "vk_wrappers/buffer.hpp"
+#include "vk_wrappers/image.hpp"
+#include "vk_wrappers/queues.hpp"
+
+// sampled texture, loading only fills staging memory and the copy is recorded into the next frame by prepare()
+struct Texture {
+    // tightly packed rgba8 pixels of level 0, the remaining levels are generated on the gpu
+    bool load_rgba(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc,
+        std::span<const uint8_t> pixels, vk::Extent2D extent, vk::Format format = vk::Format::eR8G8B8A8Srgb);
+    // 2d ktx2 file without supercompression, bcn formats the device cannot sample are decoded to rgba8
+    bool load_ktx2(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc, std::string_view path);
+
+    // records the pending upload (and mip generation), leaves the image in eReadOnlyOptimal
+    // staging memory is retired into the queue the upload is submitted to
+    void prepare(vk::raii::CommandBuffer& cmd, Queue& queue) {
+        if (!bUploadPending) return;
+        bUploadPending = false;
+        if (bLinear) {
+            // texels were written in place, only the layout changes
+            image.transition_layout_w_to_r(cmd, vk::ImageLayout::eReadOnlyOptimal, vk::PipelineStageFlagBits2::eHost,
+                vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader);
+            return;
+        }
+        image.transition_layout_r_to_w(cmd, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits2::eAllCommands, vk::PipelineStageFlagBits2::eAllTransfer);
+        cmd.copyBufferToImage(*staging.buffer, *image.image, vk::ImageLayout::eTransferDstOptimal, copies);
+        if (bGenerateMips) image.generate_mips(cmd, mipFilter);
+        image.transition_layout_w_to_r(cmd, vk::ImageLayout::eReadOnlyOptimal, vk::PipelineStageFlagBits2::eAllTransfer,
+            vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader);
+        queue.retire(std::move(staging));
+    }
+
+    Image image;
+    bool bDirect = false; // unified memory: single level textures are written into a linear image in place, set before loading
+
+private:
+    // creates the image and a staging buffer, nLevels == 0 requests a generated mip chain
+    std::byte* create(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc,
+        vk::Format format, vk::Extent2D extent, uint32_t nLevels, vk::DeviceSize stagingSize);
+    // creates a mapped linear image without staging, nullptr if the format cannot be sampled with linear tiling
+    std::byte* create_linear(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc,
+        vk::Format format, vk::Extent2D extent, vk::SubresourceLayout& layout);
+
+    Buffer staging; // only until prepare()
+    std::vector<vk::BufferImageCopy> copies;
+    vk::Filter mipFilter = vk::Filter::eLinear;
+    bool bGenerateMips = false;
+    bool bLinear = false;
+    bool bUploadPending = false;
+};
@@ -5,13 +5,16 @@ class SDL_Window;
 struct Window {
     Window(int width, int height);
     ~Window();
+    void create();
     void init(vk::raii::Instance& instance, vk::DebugUtilsMessengerEXT msg);
     void toggle_fullscreen();
     vk::Extent2D size();
     bool using_debug_msg();
 
-    SDL_Window* pWindow;
+    SDL_Window* pWindow = nullptr;
+    int initialWidth, initialHeight;
     bool bFullscreen = false;
+    bool bHidden = false; // set before create(), e.g. for headless input replays
     vk::raii::SurfaceKHR surface = nullptr;
     vk::raii::DebugUtilsMessengerEXT debugMsg = nullptr;
     std::vector<const char*> extensions;
@@ -0,0 +1,18 @@
+#version 460
+
+layout(location = 0) in vec3 inColor;
+layout(location = 1) in vec3 inPosition;
+layout(location = 2) in vec3 inNormal;
+layout(location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 2) uniform sampler2D detail;
+
+void main() {
+    // triplanar mapping in world space, meshes have no texture coordinates
+    vec3 weights = abs(normalize(inNormal));
+    weights /= weights.x + weights.y + weights.z;
+    vec3 texel = texture(detail, inPosition.yz).rgb * weights.x
+        + texture(detail, inPosition.xz).rgb * weights.y
+        + texture(detail, inPosition.xy).rgb * weights.z;
+    outColor = vec4(inColor * texel, 1.0);
+}
@@ -0,0 +1,35 @@
+#version 460
+
+// interleaved vertex layout, matches Vertex in batch.hpp
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 0) out vec3 outColor;
+layout(location = 1) out vec3 outPosition;
+layout(location = 2) out vec3 outNormal;
+
+layout(set = 0, binding = 0, std430) readonly buffer Camera {
+    mat4 viewProj;
+    vec4 lightDir;
+} camera;
+// per-object data, selected by the firstInstance of each indirect draw
+struct Object {
+    mat4 model;
+    vec4 color;
+    vec4 sphere;
+};
+layout(set = 0, binding = 1, std430) readonly buffer Objects {
+    Object objects[];
+};
+
+void main() {
+    Object object = objects[gl_InstanceIndex];
+    vec4 position = object.model * vec4(inPosition, 1.0);
+    gl_Position = camera.viewProj * position;
+
+    // simple directional light with a constant ambient term
+    vec3 normal = normalize(mat3(object.model) * inNormal);
+    float diffuse = max(dot(normal, -camera.lightDir.xyz), 0.0);
+    outColor = object.color.rgb * (0.1 + diffuse);
+    outPosition = position.xyz;
+    outNormal = normal;
+}
@@ -0,0 +1,10 @@
+#version 460
+
+layout(location = 0) out vec4 outColor;
+// cached ui layer with premultiplied alpha, same extent as the attachment
+layout(set = 0, binding = 0, rgba8) uniform readonly image2D overlayImage;
+
+void main() {
+    // blended onto the blitted scene by the pipeline
+    outColor = imageLoad(overlayImage, ivec2(gl_FragCoord.xy));
+}
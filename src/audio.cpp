@@ -0,0 +1,404 @@
+#include <fmt/base.h>
+#include <miniaudio.h>
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+//
+#include "audio.hpp"
+
+namespace {
+    // dst += src * (gain + i * delta)
+    void mix(float* pDst, const float* pSrc, float gain, float delta, uint32_t n) {
+        uint32_t i = 0;
+#if defined(__AVX__)
+        __m256 gains = _mm256_add_ps(_mm256_set1_ps(gain), _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(delta)));
+        __m256 step = _mm256_set1_ps(delta * 8.0f);
+        for (; i + 8 <= n; i += 8) {
+            __m256 sum = _mm256_add_ps(_mm256_loadu_ps(pDst + i), _mm256_mul_ps(_mm256_loadu_ps(pSrc + i), gains));
+            _mm256_storeu_ps(pDst + i, sum);
+            gains = _mm256_add_ps(gains, step);
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        __m128 gains = _mm_add_ps(_mm_set1_ps(gain), _mm_mul_ps(_mm_setr_ps(0, 1, 2, 3), _mm_set1_ps(delta)));
+        __m128 step = _mm_set1_ps(delta * 4.0f);
+        for (; i + 4 <= n; i += 4) {
+            __m128 sum = _mm_add_ps(_mm_loadu_ps(pDst + i), _mm_mul_ps(_mm_loadu_ps(pSrc + i), gains));
+            _mm_storeu_ps(pDst + i, sum);
+            gains = _mm_add_ps(gains, step);
+        }
+#endif
+        for (; i < n; i++) pDst[i] += pSrc[i] * (gain + (float)i * delta);
+    }
+
+    // linear interpolation from a 32.32 fixed point source position, reads up to two frames past the last one used
+    void resample(float* pDst, const float* pSrc, uint64_t position, uint64_t step, uint32_t n) {
+        uint32_t i = 0;
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+        // lane offsets are small floats relative to the block's integer position, the block start stays exact
+        constexpr float fixedScale = 1.0f / 4294967296.0f;
+        float stepFloat = (float)step * fixedScale;
+#endif
+#if defined(__AVX2__)
+        __m256 laneSteps = _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(stepFloat));
+        for (; i + 8 <= n; i += 8, position += step * 8) {
+            const float* pBase = pSrc + (position >> 32);
+            __m256 offsets = _mm256_add_ps(_mm256_set1_ps((float)(uint32_t)position * fixedScale), laneSteps);
+            __m256i indices = _mm256_cvttps_epi32(offsets);
+            __m256 fracs = _mm256_sub_ps(offsets, _mm256_cvtepi32_ps(indices));
+            __m256 a = _mm256_i32gather_ps(pBase, indices, 4);
+            __m256 b = _mm256_i32gather_ps(pBase + 1, indices, 4);
+            _mm256_storeu_ps(pDst + i, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), fracs)));
+        }
+#elif defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+        // no gathers, indices are computed in vectors and the samples loaded individually
+        __m128 laneSteps = _mm_mul_ps(_mm_setr_ps(0, 1, 2, 3), _mm_set1_ps(stepFloat));
+        alignas(16) int32_t indices[4];
+        for (; i + 4 <= n; i += 4, position += step * 4) {
+            const float* pBase = pSrc + (position >> 32);
+            __m128 offsets = _mm_add_ps(_mm_set1_ps((float)(uint32_t)position * fixedScale), laneSteps);
+            __m128i indexVec = _mm_cvttps_epi32(offsets);
+            __m128 fracs = _mm_sub_ps(offsets, _mm_cvtepi32_ps(indexVec));
+            _mm_store_si128((__m128i*)indices, indexVec);
+            __m128 a = _mm_setr_ps(pBase[indices[0]], pBase[indices[1]], pBase[indices[2]], pBase[indices[3]]);
+            __m128 b = _mm_setr_ps(pBase[indices[0] + 1], pBase[indices[1] + 1], pBase[indices[2] + 1], pBase[indices[3] + 1]);
+            _mm_storeu_ps(pDst + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fracs)));
+        }
+#endif
+        for (; i < n; i++, position += step) {
+            const float* pFrame = pSrc + (position >> 32);
+            float frac = (float)(uint32_t)position * (1.0f / 4294967296.0f);
+            pDst[i] = pFrame[0] + (pFrame[1] - pFrame[0]) * frac;
+        }
+    }
+
+    // planar to interleaved stereo with a ramped master gain, hard clipped to [-1, 1]
+    void interleave(float* pOut, const float* pLeft, const float* pRight, float gain, float delta, uint32_t n) {
+        uint32_t i = 0;
+#if defined(__AVX__)
+        __m256 gains = _mm256_add_ps(_mm256_set1_ps(gain), _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(delta)));
+        __m256 step = _mm256_set1_ps(delta * 8.0f);
+        __m256 lo = _mm256_set1_ps(-1.0f), hi = _mm256_set1_ps(1.0f);
+        for (; i + 8 <= n; i += 8) {
+            __m256 left = _mm256_mul_ps(_mm256_loadu_ps(pLeft + i), gains);
+            __m256 right = _mm256_mul_ps(_mm256_loadu_ps(pRight + i), gains);
+            // unpack pairs frames 0,1,4,5 and 2,3,6,7, the lane permutes restore the order
+            __m256 pairsA = _mm256_unpacklo_ps(left, right);
+            __m256 pairsB = _mm256_unpackhi_ps(left, right);
+            __m256 first = _mm256_permute2f128_ps(pairsA, pairsB, 0x20);
+            __m256 second = _mm256_permute2f128_ps(pairsA, pairsB, 0x31);
+            _mm256_storeu_ps(pOut + i * 2, _mm256_min_ps(_mm256_max_ps(first, lo), hi));
+            _mm256_storeu_ps(pOut + i * 2 + 8, _mm256_min_ps(_mm256_max_ps(second, lo), hi));
+            gains = _mm256_add_ps(gains, step);
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        __m128 gains = _mm_add_ps(_mm_set1_ps(gain), _mm_mul_ps(_mm_setr_ps(0, 1, 2, 3), _mm_set1_ps(delta)));
+        __m128 step = _mm_set1_ps(delta * 4.0f);
+        __m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f);
+        for (; i + 4 <= n; i += 4) {
+            __m128 left = _mm_mul_ps(_mm_loadu_ps(pLeft + i), gains);
+            __m128 right = _mm_mul_ps(_mm_loadu_ps(pRight + i), gains);
+            _mm_storeu_ps(pOut + i * 2, _mm_min_ps(_mm_max_ps(_mm_unpacklo_ps(left, right), lo), hi));
+            _mm_storeu_ps(pOut + i * 2 + 4, _mm_min_ps(_mm_max_ps(_mm_unpackhi_ps(left, right), lo), hi));
+            gains = _mm_add_ps(gains, step);
+        }
+#endif
+        for (; i < n; i++) {
+            float frameGain = gain + (float)i * delta;
+            pOut[i * 2 + 0] = std::clamp(pLeft[i] * frameGain, -1.0f, 1.0f);
+            pOut[i * 2 + 1] = std::clamp(pRight[i] * frameGain, -1.0f, 1.0f);
+        }
+    }
+
+    void data_callback(ma_device* pDevice, void* pOutput, const void*, ma_uint32 frameCount) {
+        static_cast<Audio::Mixer*>(pDevice->pUserData)->render(static_cast<float*>(pOutput), frameCount);
+    }
+}
+
+namespace Audio {
+    Mixer::Mixer() = default;
+    Mixer::~Mixer() {
+        shutdown();
+    }
+    bool Mixer::init(const Config& newConfig) {
+        shutdown();
+        config = newConfig;
+        sampleRate = config.sampleRate;
+        periodFrames = config.periodFrames;
+        pContext = std::make_unique<ma_context>();
+        ma_backend nullBackend = ma_backend_null;
+        if (ma_context_init(config.bNullBackend ? &nullBackend : nullptr, config.bNullBackend ? 1 : 0, nullptr, pContext.get()) != MA_SUCCESS) {
+            fmt::println("could not initialize audio context");
+            pContext.reset();
+            return false;
+        }
+
+        // the mixer writes and clips every frame itself
+        ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
+        deviceConfig.playback.format = ma_format_f32;
+        deviceConfig.playback.channels = 2;
+        deviceConfig.sampleRate = config.sampleRate;
+        deviceConfig.periodSizeInFrames = config.periodFrames;
+        deviceConfig.periods = config.nPeriods;
+        deviceConfig.performanceProfile = ma_performance_profile_low_latency;
+        deviceConfig.noPreSilencedOutputBuffer = MA_TRUE;
+        deviceConfig.noClip = MA_TRUE;
+        deviceConfig.dataCallback = data_callback;
+        deviceConfig.pUserData = this;
+        pDevice = std::make_unique<ma_device>();
+        if (ma_device_init(pContext.get(), &deviceConfig, pDevice.get()) != MA_SUCCESS) {
+            fmt::println("could not open audio device");
+            pDevice.reset();
+            shutdown();
+            return false;
+        }
+        sampleRate = pDevice->sampleRate;
+        periodFrames = pDevice->playback.internalPeriodSizeInFrames;
+        if (ma_device_start(pDevice.get()) != MA_SUCCESS) {
+            fmt::println("could not start audio device");
+            shutdown();
+            return false;
+        }
+        fmt::println("audio: {} Hz, {} frame periods ({:.1f} ms)", sampleRate, periodFrames, periodFrames * 1000.0f / sampleRate);
+        return true;
+    }
+    void Mixer::shutdown() {
+        // uninit stops the device and waits for the callback to return
+        if (pDevice) ma_device_uninit(pDevice.get());
+        if (pContext) ma_context_uninit(pContext.get());
+        pDevice.reset();
+        pContext.reset();
+
+        // no callback runs anymore, pending plays and every active voice are released here before the streams go away
+        // so evicted clips reach nPlaying 0 and nothing resumes on the next init()
+        process_commands();
+        for (Voice& voice : voices) release(voice);
+        if (worker.joinable()) {
+            {
+                std::lock_guard lock(streamMutex);
+                bStopWorker = true;
+            }
+            streamCv.notify_one();
+            worker.join();
+            bStopWorker = false;
+        }
+        streams.clear();
+    }
+
+    uint32_t Mixer::load(std::string_view path) {
+        ma_decoder_config decoderConfig = ma_decoder_config_init(ma_format_f32, 0, 0);
+        ma_decoder decoder;
+        if (ma_decoder_init_file(std::string(path).c_str(), &decoderConfig, &decoder) != MA_SUCCESS) {
+            fmt::println("could not decode sound: {}", path);
+            return UINT32_MAX;
+        }
+        std::vector<float> interleaved;
+        std::array<float, 4096> chunk;
+        uint32_t nChannels = decoder.outputChannels;
+        for (;;) {
+            ma_uint64 nRead = 0;
+            ma_decoder_read_pcm_frames(&decoder, chunk.data(), chunk.size() / nChannels, &nRead);
+            if (nRead == 0) break;
+            interleaved.insert(interleaved.end(), chunk.begin(), chunk.begin() + nRead * nChannels);
+        }
+        uint32_t rate = decoder.outputSampleRate;
+        ma_decoder_uninit(&decoder);
+        return load(interleaved, nChannels, rate);
+    }
+    uint32_t Mixer::load(std::span<const float> interleaved, uint32_t nChannels, uint32_t rate) {
+        if (nChannels == 0 || rate == 0 || interleaved.size() < nChannels) return UINT32_MAX;
+        fill_sound(sounds.emplace_back(), interleaved, nChannels, rate);
+        return (uint32_t)sounds.size() - 1;
+    }
+    void fill_sound(Sound& sound, std::span<const float> interleaved, uint32_t nChannels, uint32_t rate) {
+        // channels past the second are dropped, two frames of padding keep interpolation in bounds
+        sound.nFrames = (uint32_t)(interleaved.size() / nChannels);
+        sound.sampleRate = rate;
+        sound.left.resize(sound.nFrames + 2);
+        if (nChannels > 1) sound.right.resize(sound.nFrames + 2);
+        for (uint32_t i = 0; i < sound.nFrames; i++) {
+            sound.left[i] = interleaved[i * nChannels];
+            if (nChannels > 1) sound.right[i] = interleaved[i * nChannels + 1];
+        }
+        for (std::vector<float>* pChannel : { &sound.left, &sound.right }) {
+            if (pChannel->empty()) continue;
+            (*pChannel)[sound.nFrames] = (*pChannel)[sound.nFrames + 1] = (*pChannel)[sound.nFrames - 1];
+        }
+    }
+
+    uint32_t Mixer::play(uint32_t sound, float gain, float pan, float pitch, bool bLoop) {
+        if (sound >= sounds.size()) return 0;
+        return play(sounds[sound], gain, pan, pitch, bLoop);
+    }
+    uint32_t Mixer::play(const Sound& sound, float gain, float pan, float pitch, bool bLoop) {
+        // counted before sending, the callback releases it once the voice ends
+        sound.nPlaying.fetch_add(1, std::memory_order_relaxed);
+        uint32_t handle = send_play({ .pSound = &sound, .gain = gain, .pan = pan, .pitch = pitch, .bLoop = bLoop });
+        if (handle == 0) sound.nPlaying.fetch_sub(1, std::memory_order_relaxed);
+        return handle;
+    }
+    void Mixer::set_gain(uint32_t voice, float gain, float pan) {
+        send({ .type = Command::Type::eGain, .voice = voice, .gain = gain, .pan = pan });
+    }
+    void Mixer::stop(uint32_t voice) {
+        send({ .type = Command::Type::eStop, .voice = voice });
+    }
+    void Mixer::stop_all() {
+        send({ .type = Command::Type::eStopAll });
+    }
+    void Mixer::set_master(float gain) {
+        send({ .type = Command::Type::eMaster, .gain = gain });
+    }
+    uint32_t Mixer::send_play(Command command) {
+        command.type = Command::Type::ePlay;
+        command.voice = nextHandle++;
+        if (nextHandle == 0) nextHandle = 1;
+        return send(command) ? command.voice : 0;
+    }
+    bool Mixer::send(const Command& command) {
+        if (commands.push(command)) return true;
+        fmt::println("audio command queue is full");
+        return false;
+    }
+
+    void Mixer::render(float* pOutput, uint32_t nFrames) {
+        auto start = std::chrono::steady_clock::now();
+        process_commands();
+        for (uint32_t offset = 0; offset < nFrames; offset += blockFrames) {
+            uint32_t nBlock = std::min(blockFrames, nFrames - offset);
+            std::fill_n(mixLeft.begin(), nBlock, 0.0f);
+            std::fill_n(mixRight.begin(), nBlock, 0.0f);
+            for (Voice& voice : voices) {
+                if (voice.pSound != nullptr) mix_voice(voice, nBlock);
+                else if (voice.pStream != nullptr) mix_stream(voice, nBlock);
+            }
+            interleave(pOutput + offset * 2, mixLeft.data(), mixRight.data(), masterGain, (masterTarget - masterGain) / nBlock, nBlock);
+            masterGain = masterTarget;
+        }
+        uint32_t nActive = (uint32_t)std::ranges::count_if(voices, [](const Voice& voice) { return voice.active(); });
+        nActiveVoices.store(nActive, std::memory_order_relaxed);
+        nCallbacks.fetch_add(1, std::memory_order_relaxed);
+        pVoices->set(nActive);
+        pCallbackTime->record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    void Mixer::process_commands() {
+        Command command;
+        while (commands.pop(command)) {
+            auto voice = std::ranges::find_if(voices, [&](const Voice& voice) { return voice.active() && voice.handle == command.voice; });
+            switch (command.type) {
+                case Command::Type::ePlay: {
+                    // take a free voice, else replace the oldest one
+                    voice = std::ranges::find_if(voices, [](const Voice& voice) { return !voice.active(); });
+                    if (voice == voices.end()) {
+                        voice = std::ranges::min_element(voices, {}, [&](const Voice& voice) { return voice.handle - command.voice; });
+                        release(*voice);
+                        nStolenVoices.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    // streams are decoded at the device rate
+                    double ratio = command.pSound != nullptr ? (double)command.pSound->sampleRate / sampleRate * std::max(command.pitch, 0.0f) : 1.0;
+                    *voice = { .pSound = command.pSound, .pStream = command.pStream, .handle = command.voice, .step = (uint64_t)(ratio * 4294967296.0), .bLoop = command.bLoop };
+                    set_target(*voice, command.gain, command.pan);
+                    voice->gainLeft = voice->targetLeft;
+                    voice->gainRight = voice->targetRight;
+                    if (voice->step == 0) release(*voice);
+                    break;
+                }
+                case Command::Type::eGain:
+                    if (voice != voices.end() && !voice->bStopping) set_target(*voice, command.gain, command.pan);
+                    break;
+                case Command::Type::eStop:
+                    if (voice != voices.end()) voice->bStopping = true;
+                    break;
+                case Command::Type::eStopAll:
+                    for (Voice& each : voices) each.bStopping = true;
+                    break;
+                case Command::Type::eMaster:
+                    masterTarget = command.gain;
+                    break;
+            }
+        }
+        for (Voice& voice : voices) {
+            if (voice.bStopping) voice.targetLeft = voice.targetRight = 0.0f;
+        }
+    }
+    void Mixer::set_target(Voice& voice, float gain, float pan) {
+        pan = std::clamp(pan, -1.0f, 1.0f);
+        if (voice.pSound != nullptr && voice.pSound->right.empty()) {
+            // constant power pan of mono sounds
+            float angle = (pan + 1.0f) * 0.25f * 3.14159265f;
+            voice.targetLeft = gain * std::cos(angle);
+            voice.targetRight = gain * std::sin(angle);
+        }
+        else {
+            // balance of stereo sounds and streams
+            voice.targetLeft = gain * std::min(1.0f, 1.0f - pan);
+            voice.targetRight = gain * std::min(1.0f, 1.0f + pan);
+        }
+    }
+    void Mixer::release(Voice& voice) {
+        if (voice.pSound != nullptr) voice.pSound->nPlaying.fetch_sub(1, std::memory_order_release);
+        if (voice.pStream != nullptr) voice.pStream->bReleased.store(true, std::memory_order_release);
+        voice.pSound = nullptr;
+        voice.pStream = nullptr;
+    }
+    void Mixer::mix_voice(Voice& voice, uint32_t nFrames) {
+        const Sound& sound = *voice.pSound;
+        const bool bStereo = !sound.right.empty();
+        const uint64_t end = (uint64_t)sound.nFrames << 32;
+        float deltaLeft = (voice.targetLeft - voice.gainLeft) / nFrames;
+        float deltaRight = (voice.targetRight - voice.gainRight) / nFrames;
+        uint32_t done = 0;
+        while (done < nFrames) {
+            if (voice.position >= end) {
+                if (!voice.bLoop) break;
+                voice.position -= end;
+                continue;
+            }
+            // frames until the position passes the last source frame
+            uint32_t count = (uint32_t)std::min<uint64_t>(nFrames - done, (end - voice.position + voice.step - 1) / voice.step);
+            const float* pLeft = sound.left.data() + (voice.position >> 32);
+            const float* pRight = bStereo ? sound.right.data() + (voice.position >> 32) : pLeft;
+            if (voice.step != 1ull << 32 || (uint32_t)voice.position != 0) {
+                resample(scratchLeft.data(), sound.left.data(), voice.position, voice.step, count);
+                if (bStereo) resample(scratchRight.data(), sound.right.data(), voice.position, voice.step, count);
+                pLeft = scratchLeft.data();
+                pRight = bStereo ? scratchRight.data() : pLeft;
+            }
+            mix(mixLeft.data() + done, pLeft, voice.gainLeft + deltaLeft * done, deltaLeft, count);
+            mix(mixRight.data() + done, pRight, voice.gainRight + deltaRight * done, deltaRight, count);
+            voice.position += voice.step * count;
+            done += count;
+        }
+        voice.gainLeft = voice.targetLeft;
+        voice.gainRight = voice.targetRight;
+        if (done < nFrames || voice.bStopping) release(voice);
+    }
+    void Mixer::mix_stream(Voice& voice, uint32_t nFrames) {
+        Stream& stream = *voice.pStream;
+        // checked before reading, a short read after the source ended is the end of the stream
+        bool bDecoded = stream.bDecoded.load(std::memory_order_acquire);
+        uint32_t count = (uint32_t)stream.ring.read(scratchStream.data(), nFrames * 2) / 2;
+        for (uint32_t i = 0; i < count; i++) {
+            scratchLeft[i] = scratchStream[i * 2 + 0];
+            scratchRight[i] = scratchStream[i * 2 + 1];
+        }
+        float deltaLeft = (voice.targetLeft - voice.gainLeft) / nFrames;
+        float deltaRight = (voice.targetRight - voice.gainRight) / nFrames;
+        mix(mixLeft.data(), scratchLeft.data(), voice.gainLeft, deltaLeft, count);
+        mix(mixRight.data(), scratchRight.data(), voice.gainRight, deltaRight, count);
+        voice.gainLeft = voice.targetLeft;
+        voice.gainRight = voice.targetRight;
+        // the worker fell behind, the rest of the block stays silent
+        if (count < nFrames && !bDecoded) {
+            nUnderruns.fetch_add(1, std::memory_order_relaxed);
+            pUnderruns->add();
+        }
+        if ((count < nFrames && bDecoded) || voice.bStopping) release(voice);
+    }
+}
@@ -0,0 +1,173 @@
+#include <fmt/base.h>
+#include <miniaudio.h>
+//
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+//
+#include "audio.hpp"
+
+namespace {
+    // read-only mapping of a whole file, decoded front to back
+    const std::byte* map_file(std::string_view path, size_t& size) {
+        int fd = ::open(std::string(path).c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+            ::close(fd);
+            return nullptr;
+        }
+        size = fileStat.st_size;
+        void* pMap = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (pMap == MAP_FAILED) return nullptr;
+        madvise(pMap, size, MADV_SEQUENTIAL);
+        return static_cast<const std::byte*>(pMap);
+    }
+}
+
+namespace Audio {
+    Stream::Stream() = default;
+    Stream::~Stream() {
+        if (pDecoder) ma_decoder_uninit(pDecoder.get());
+        if (pData != nullptr) munmap(const_cast<std::byte*>(pData), size);
+    }
+    bool Stream::open(std::string_view path, uint32_t sampleRate, uint32_t bufferFrames, bool bLoopSource) {
+        pData = map_file(path, size);
+        if (pData == nullptr) {
+            fmt::println("could not open sound: {}", path);
+            return false;
+        }
+        // the decoder converts to the mixer's layout, so the callback only copies
+        pDecoder = std::make_unique<ma_decoder>();
+        ma_decoder_config decoderConfig = ma_decoder_config_init(ma_format_f32, 2, sampleRate);
+        if (ma_decoder_init_memory(pData, size, &decoderConfig, pDecoder.get()) != MA_SUCCESS) {
+            fmt::println("could not decode sound: {}", path);
+            pDecoder.reset();
+            return false;
+        }
+        ring.resize((size_t)bufferFrames * 2);
+        bLoop = bLoopSource;
+        return true;
+    }
+    void Stream::fill(std::span<float> scratch) {
+        if (!pDecoder || bDecoded.load(std::memory_order_relaxed)) return;
+        bool bRewound = false;
+        for (;;) {
+            ma_uint64 nFrames = std::min(ring.writable(), scratch.size()) / 2;
+            if (nFrames == 0) return;
+            ma_uint64 nRead = 0;
+            ma_decoder_read_pcm_frames(pDecoder.get(), scratch.data(), nFrames, &nRead);
+            ring.write(scratch.data(), nRead * 2);
+            if (nRead == nFrames) {
+                bRewound = false;
+                continue;
+            }
+            // end of the source, a rewound source without frames is empty
+            if (bLoop && !(bRewound && nRead == 0)) {
+                ma_decoder_seek_to_pcm_frame(pDecoder.get(), 0);
+                bRewound = true;
+                continue;
+            }
+            bDecoded.store(true, std::memory_order_release);
+            return;
+        }
+    }
+
+    uint32_t Mixer::play_file(std::string_view path, float gain, float pan, bool bLoop) {
+        std::erase_if(evictedClips, [](const std::unique_ptr<Sound>& pSound) { return pSound->nPlaying.load(std::memory_order_acquire) == 0; });
+        if (const Sound* pClip = load_clip(path)) return play(*pClip, gain, pan, 1.0f, bLoop);
+
+        // the first part is decoded here, so playback starts without waiting for the worker
+        auto pStream = std::make_unique<Stream>();
+        if (!pStream->open(path, sampleRate, sampleRate * config.streamBufferMs / 1000, bLoop)) return 0;
+        std::vector<float> scratch(4096 * 2);
+        pStream->fill(scratch);
+        Stream* pPlaying = pStream.get();
+        {
+            std::lock_guard lock(streamMutex);
+            streams.push_back(std::move(pStream));
+        }
+        if (!worker.joinable()) worker = std::thread([this] { work(); });
+        uint32_t handle = send_play({ .pStream = pPlaying, .gain = gain, .pan = pan, .bLoop = bLoop });
+        if (handle == 0) pPlaying->bReleased.store(true, std::memory_order_release);
+        return handle;
+    }
+    const Sound* Mixer::load_clip(std::string_view path) {
+        std::string key = std::string(path);
+        auto cached = clipLookup.find(key);
+        if (cached != clipLookup.end()) {
+            clips.splice(clips.begin(), clips, cached->second);
+            return clips.front().pSound.get();
+        }
+
+        // only files of known and short length that fit into the cache are decoded whole
+        size_t size = 0;
+        const std::byte* pData = map_file(path, size);
+        if (pData == nullptr) return nullptr;
+        ma_decoder_config decoderConfig = ma_decoder_config_init(ma_format_f32, 0, 0);
+        ma_decoder decoder;
+        if (ma_decoder_init_memory(pData, size, &decoderConfig, &decoder) != MA_SUCCESS) {
+            munmap(const_cast<std::byte*>(pData), size);
+            return nullptr;
+        }
+        ma_uint64 length = 0;
+        uint32_t nChannels = decoder.outputChannels;
+        size_t bytes = 0;
+        bool bClip = ma_decoder_get_length_in_pcm_frames(&decoder, &length) == MA_SUCCESS && length > 0
+            && length <= config.clipSeconds * decoder.outputSampleRate;
+        bytes = (size_t)length * std::min(nChannels, 2u) * sizeof(float);
+        bClip &= bytes <= config.clipCacheBytes;
+        std::unique_ptr<Sound> pSound;
+        if (bClip) {
+            std::vector<float> interleaved(length * nChannels);
+            ma_uint64 nRead = 0;
+            ma_decoder_read_pcm_frames(&decoder, interleaved.data(), length, &nRead);
+            interleaved.resize(nRead * nChannels);
+            if (nRead > 0) {
+                pSound = std::make_unique<Sound>();
+                fill_sound(*pSound, interleaved, nChannels, decoder.outputSampleRate);
+            }
+        }
+        ma_decoder_uninit(&decoder);
+        munmap(const_cast<std::byte*>(pData), size);
+        if (!pSound) return nullptr;
+
+        // least recently used clips beyond the budget are dropped, or kept aside while they still play
+        clips.emplace_front(key, std::move(pSound), bytes);
+        clipLookup[key] = clips.begin();
+        clipBytes += bytes;
+        while (clipBytes > config.clipCacheBytes && clips.size() > 1) {
+            Clip& oldest = clips.back();
+            clipBytes -= oldest.bytes;
+            clipLookup.erase(oldest.path);
+            if (oldest.pSound->nPlaying.load(std::memory_order_acquire) > 0) evictedClips.push_back(std::move(oldest.pSound));
+            clips.pop_back();
+        }
+        pClipBytes->set((double)clipBytes);
+        return clips.front().pSound.get();
+    }
+    void Mixer::work() {
+        std::vector<float> scratch(4096 * 2);
+        std::vector<Stream*> pending;
+        std::unique_lock lock(streamMutex);
+        while (!bStopWorker) {
+            // streams the callback let go of are destroyed, the emptiest rings are filled first
+            std::erase_if(streams, [](const std::unique_ptr<Stream>& pStream) { return pStream->bReleased.load(std::memory_order_acquire); });
+            pending.clear();
+            for (std::unique_ptr<Stream>& pStream : streams) pending.push_back(pStream.get());
+            pStreams->set((double)streams.size());
+            std::ranges::sort(pending, {}, [](Stream* pStream) { return pStream->ring.readable(); });
+            // only the worker destroys streams, so decoding can run without the lock
+            lock.unlock();
+            for (Stream* pStream : pending) pStream->fill(scratch);
+            lock.lock();
+            // waking every quarter of the buffer keeps each ring well ahead of the callback
+            streamCv.wait_for(lock, std::chrono::milliseconds(std::max(1u, config.streamBufferMs / 4)), [this] { return bStopWorker; });
+        }
+    }
+}
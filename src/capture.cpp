@@ -0,0 +1,316 @@
+#include <vulkan/vulkan_raii.hpp>
+#include <fmt/base.h>
+#include <fmt/format.h>
+//
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+//
+#include "capture.hpp"
+
+namespace {
+    // ieee half to float, the cpu fallback reads the renderer's rgba16f image directly
+    float half_to_float(uint16_t half) {
+        uint32_t sign = (half & 0x8000u) << 16;
+        uint32_t exponent = (half >> 10) & 0x1f;
+        uint32_t mantissa = half & 0x3ff;
+        if (exponent == 0) {
+            // zero or subnormal
+            float value = std::ldexp((float)mantissa, -24);
+            return sign ? -value : value;
+        }
+        if (exponent == 31) return std::bit_cast<float>(sign | 0x7f800000u | mantissa << 13);
+        return std::bit_cast<float>(sign | (exponent + 112) << 23 | mantissa << 13);
+    }
+    uint8_t unorm8(float value) {
+        return (uint8_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+
+    // png checksums
+    constexpr std::array<uint32_t, 256> crcTable = [] {
+        std::array<uint32_t, 256> table;
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (uint32_t k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }();
+    uint32_t crc32(const uint8_t* pData, size_t size, uint32_t crc = 0) {
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) crc = crcTable[(crc ^ pData[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+    uint32_t adler32(const uint8_t* pData, size_t size) {
+        // sums are reduced every 5552 bytes, the most that cannot overflow 32 bits
+        uint32_t a = 1, b = 0;
+        while (size > 0) {
+            size_t n = std::min<size_t>(size, 5552);
+            for (size_t i = 0; i < n; i++) {
+                a += pData[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+            pData += n;
+            size -= n;
+        }
+        return b << 16 | a;
+    }
+    void append_u32(std::vector<uint8_t>& out, uint32_t value) {
+        out.insert(out.end(), { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value });
+    }
+    // length, type, data, crc over type and data
+    void append_chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* pData, size_t size) {
+        append_u32(out, (uint32_t)size);
+        size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), pData, pData + size);
+        append_u32(out, crc32(out.data() + start, size + 4));
+    }
+}
+
+bool Capture::start(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc, Tasks::Scheduler& tasks,
+        const Image& image, std::string_view path, uint32_t nFrames, uint32_t fps) {
+    stop();
+    pDevice = &device;
+    pAlloc = &alloc;
+    pTasks = &tasks;
+    extent = vk::Extent2D(image.extent.width, image.extent.height);
+    sourceFormat = image.format;
+    this->path = path;
+    this->fps = fps;
+    bY4m = path.ends_with(".y4m");
+    nFramesRequested = nFrames;
+    nRecorded = 0;
+    nCaptured = 0;
+    nDropped = 0;
+
+    // convert to rgba8 with a blit where possible, else the raw rgba16f texels are converted by the worker
+    vk::FormatFeatureFlags srcFeatures = physDevice.getFormatProperties(sourceFormat).optimalTilingFeatures;
+    vk::FormatFeatureFlags dstFeatures = physDevice.getFormatProperties(vk::Format::eR8G8B8A8Unorm).optimalTilingFeatures;
+    bConvertOnGpu = (srcFeatures & vk::FormatFeatureFlagBits::eBlitSrc) && (dstFeatures & vk::FormatFeatureFlagBits::eBlitDst);
+    if (!bConvertOnGpu && sourceFormat != vk::Format::eR16G16B16A16Sfloat) {
+        fmt::println("capture: unsupported image format {}", (uint32_t)sourceFormat);
+        return false;
+    }
+    if (bY4m) {
+        stream.open(this->path, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            fmt::println("capture: could not open {}", path);
+            return false;
+        }
+        // full range bt.601 with 2x2 subsampled chroma
+        stream << fmt::format("YUV4MPEG2 W{} H{} F{}:1 Ip A1:1 C420jpeg\n", extent.width, extent.height, fps);
+    }
+    if (bConvertOnGpu) {
+        converted = Image(device, alloc, vk::Extent3D(extent, 1), vk::Format::eR8G8B8A8Unorm,
+            vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst, vk::ImageAspectFlagBits::eColor);
+    }
+
+    // host cached readback memory, the worker reads every byte
+    vk::DeviceSize size = (vk::DeviceSize)extent.width * extent.height * (bConvertOnGpu ? 4 : 8);
+    for (Slot& slot : slots) {
+        slot.buffer = Buffer(alloc, size, vk::BufferUsageFlagBits::eTransferDst,
+            vma::AllocationCreateFlagBits::eHostAccessRandom | vma::AllocationCreateFlagBits::eMapped);
+        slot.state = SlotState::eFree;
+    }
+    nCopying = 0;
+
+    bStopping = false;
+    worker = std::thread(&Capture::work, this);
+    bActive = true;
+    return true;
+}
+void Capture::stop() {
+    if (!bActive) return;
+    bActive = false;
+    // every recorded copy has been submitted by now, their tasks hand them to the worker
+    while (nCopying > 0) pTasks->wait(*pDevice);
+    {
+        std::lock_guard lock(mutex);
+        bStopping = true;
+    }
+    cv.notify_all();
+    worker.join();
+    if (stream.is_open()) stream.close();
+    fmt::println("captured {} frames to {}, {} dropped", nCaptured, path, nDropped);
+
+    slots = {};
+    converted = {};
+}
+
+void Capture::record(vk::raii::CommandBuffer& cmd, Image& image, Queue& queue) {
+    if (!bActive || (nFramesRequested > 0 && nRecorded >= nFramesRequested)) return;
+    Slot* pSlot = nullptr;
+    {
+        std::lock_guard lock(mutex);
+        auto it = std::ranges::find(slots, SlotState::eFree, &Slot::state);
+        if (it != slots.end()) pSlot = &*it;
+    }
+    if (pSlot == nullptr) {
+        nDropped++;
+        return;
+    }
+
+    image.transition_layout_w_to_r(cmd, vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits2::eAllCommands, vk::PipelineStageFlagBits2::eAllTransfer);
+    Image* pSource = &image;
+    if (bConvertOnGpu) {
+        // previous contents were already copied out, earlier transfers are covered by the barrier
+        converted.lastKnownLayout = vk::ImageLayout::eUndefined;
+        converted.transition_layout_r_to_w(cmd, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits2::eAllTransfer, vk::PipelineStageFlagBits2::eAllTransfer);
+        vk::Offset3D size = vk::Offset3D(extent.width, extent.height, 1);
+        vk::ImageBlit2 blitRegion = vk::ImageBlit2()
+            .setSrcSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+            .setSrcOffsets({ vk::Offset3D(), size })
+            .setDstSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+            .setDstOffsets({ vk::Offset3D(), size });
+        vk::BlitImageInfo2 blitInfo = vk::BlitImageInfo2()
+            .setSrcImage(*image.image).setSrcImageLayout(vk::ImageLayout::eTransferSrcOptimal)
+            .setDstImage(*converted.image).setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
+            .setRegions(blitRegion)
+            .setFilter(vk::Filter::eNearest);
+        cmd.blitImage2(blitInfo);
+        converted.transition_layout_w_to_r(cmd, vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits2::eAllTransfer, vk::PipelineStageFlagBits2::eAllTransfer);
+        pSource = &converted;
+    }
+    vk::BufferImageCopy2 copyRegion = vk::BufferImageCopy2()
+        .setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+        .setImageExtent(vk::Extent3D(extent, 1));
+    vk::CopyImageToBufferInfo2 copyInfo = vk::CopyImageToBufferInfo2()
+        .setSrcImage(*pSource->image).setSrcImageLayout(vk::ImageLayout::eTransferSrcOptimal)
+        .setDstBuffer(*pSlot->buffer.buffer)
+        .setRegions(copyRegion);
+    cmd.copyImageToBuffer2(copyInfo);
+
+    // make the copy visible to the host once the frame's timeline value is signaled
+    vk::BufferMemoryBarrier2 hostBarrier = vk::BufferMemoryBarrier2()
+        .setSrcStageMask(vk::PipelineStageFlagBits2::eAllTransfer)
+        .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+        .setDstStageMask(vk::PipelineStageFlagBits2::eHost)
+        .setDstAccessMask(vk::AccessFlagBits2::eHostRead)
+        .setBuffer(*pSlot->buffer.buffer)
+        .setSize(vk::WholeSize);
+    cmd.pipelineBarrier2(vk::DependencyInfo().setBufferMemoryBarriers(hostBarrier));
+    image.transition_layout_r_to_rw(cmd, vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits2::eAllTransfer, vk::PipelineStageFlagBits2::eAllCommands);
+
+    pSlot->frame = nRecorded++;
+    pSlot->state = SlotState::eCopying;
+    nCopying++;
+    pTasks->spawn(readback(queue, queue.timelineValue + 1, *pSlot));
+}
+Tasks::Task Capture::readback(Queue& queue, uint64_t value, Slot& slot) {
+    co_await Tasks::timeline(queue, value);
+    // tasks resume in spawn order once their values are reached, the y4m stream depends on it
+    {
+        std::lock_guard lock(mutex);
+        slot.state = SlotState::eEncoding;
+        jobs.push_back((uint32_t)(&slot - slots.data()));
+    }
+    nCopying--;
+    nCaptured++;
+    cv.notify_one();
+}
+
+void Capture::work() {
+    while (true) {
+        uint32_t iSlot;
+        {
+            std::unique_lock lock(mutex);
+            cv.wait(lock, [&] { return bStopping || !jobs.empty(); });
+            if (jobs.empty()) return;
+            iSlot = jobs.front();
+            jobs.pop_front();
+        }
+        encode(slots[iSlot]);
+        std::lock_guard lock(mutex);
+        slots[iSlot].state = SlotState::eFree;
+    }
+}
+void Capture::encode(Slot& slot) {
+    (*pAlloc)->invalidateAllocation(*slot.buffer.allocation, 0, vk::WholeSize);
+    // tightly packed rgb8, alpha is dropped
+    size_t nPixels = (size_t)extent.width * extent.height;
+    rgb.resize(nPixels * 3);
+    if (bConvertOnGpu) {
+        const uint8_t* pSrc = static_cast<const uint8_t*>(slot.buffer.pMapped);
+        for (size_t i = 0; i < nPixels; i++) std::memcpy(&rgb[i * 3], &pSrc[i * 4], 3);
+    }
+    else {
+        const uint16_t* pSrc = static_cast<const uint16_t*>(slot.buffer.pMapped);
+        for (size_t i = 0; i < nPixels; i++) {
+            for (size_t c = 0; c < 3; c++) rgb[i * 3 + c] = unorm8(half_to_float(pSrc[i * 4 + c]));
+        }
+    }
+    if (bY4m) write_y4m();
+    else write_png(slot.frame);
+}
+
+void Capture::write_png(uint32_t frame) {
+    // scanlines with filter type 0, stored in uncompressed deflate blocks: encoding keeps up with the render rate
+    size_t rowSize = (size_t)extent.width * 3;
+    std::vector<uint8_t> raw;
+    raw.reserve((rowSize + 1) * extent.height);
+    for (uint32_t y = 0; y < extent.height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + y * rowSize, rgb.begin() + (y + 1) * rowSize);
+    }
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    for (size_t offset = 0;; offset += 65535) {
+        uint16_t size = (uint16_t)std::min<size_t>(raw.size() - offset, 65535);
+        bool bFinal = offset + size >= raw.size();
+        zlib.insert(zlib.end(), { (uint8_t)bFinal, (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)~size, (uint8_t)(~size >> 8) });
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        if (bFinal) break;
+    }
+    append_u32(zlib, adler32(raw.data(), raw.size()));
+
+    encoded.assign({ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' });
+    std::vector<uint8_t> header;
+    append_u32(header, extent.width);
+    append_u32(header, extent.height);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit rgb, deflate, no interlace
+    append_chunk(encoded, "IHDR", header.data(), header.size());
+    append_chunk(encoded, "IDAT", zlib.data(), zlib.size());
+    append_chunk(encoded, "IEND", nullptr, 0);
+
+    // single frame captures use the path as is
+    std::string file = nFramesRequested == 1 && path.ends_with(".png") ? path : fmt::format("{}_{:05}.png", path, frame);
+    std::ofstream(file, std::ios::binary).write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+}
+void Capture::write_y4m() {
+    // bt.601 full range in 16 bit fixed point, chroma from the mean of each 2x2 block
+    uint32_t width = extent.width, height = extent.height;
+    uint32_t chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    encoded.resize((size_t)width * height + 2 * (size_t)chromaWidth * chromaHeight);
+    uint8_t* pY = encoded.data();
+    uint8_t* pU = pY + (size_t)width * height;
+    uint8_t* pV = pU + (size_t)chromaWidth * chromaHeight;
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        int32_t r = rgb[i * 3], g = rgb[i * 3 + 1], b = rgb[i * 3 + 2];
+        pY[i] = (uint8_t)((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+    }
+    for (uint32_t cy = 0; cy < chromaHeight; cy++) {
+        for (uint32_t cx = 0; cx < chromaWidth; cx++) {
+            int32_t r = 0, g = 0, b = 0, n = 0;
+            for (uint32_t y = cy * 2; y < std::min(cy * 2 + 2, height); y++) {
+                for (uint32_t x = cx * 2; x < std::min(cx * 2 + 2, width); x++) {
+                    const uint8_t* pPixel = &rgb[((size_t)y * width + x) * 3];
+                    r += pPixel[0];
+                    g += pPixel[1];
+                    b += pPixel[2];
+                    n++;
+                }
+            }
+            r /= n; g /= n; b /= n;
+            size_t i = (size_t)cy * chromaWidth + cx;
+            pU[i] = (uint8_t)std::clamp(((-11059 * r - 21709 * g + 32768 * b + 32768) >> 16) + 128, 0, 255);
+            pV[i] = (uint8_t)std::clamp(((32768 * r - 27439 * g - 5329 * b + 32768) >> 16) + 128, 0, 255);
+        }
+    }
+    stream << "FRAME\n";
+    stream.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+}
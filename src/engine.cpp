@@ -3,34 +3,52 @@
 #include <SDL3/SDL_events.h>
 #include <fmt/base.h>
 //
+#include <future>
+//
 #include "engine.hpp"
 #include "window.hpp"
 #include "renderer.hpp"
 #include "vk_wrappers/imgui_impl.hpp"
+#include "vk_wrappers/memory.hpp"
 #include "vk_wrappers/swapchain.hpp"
 #include "vk_wrappers/queues.hpp"
 
-Engine::Engine() {
+Engine::Engine(std::string_view meshPath, std::string_view texturePath, bool bHeadless): bHeadless(bHeadless) {
+    // vulkan loader and SDL video subsystem are initialized in member initializers
+    startup.stage("loader_sdl");
+
+    // shader reflection only depends on the embedded SPIR-V
+    std::future<void> reflectTask = std::async(std::launch::async, [&] { renderer.reflect(); });
+    renderer.meshPath = meshPath;
+    renderer.texturePath = texturePath;
+
     // Vulkan: dynamic dispatcher init 1/3
     VULKAN_HPP_DEFAULT_DISPATCHER.init();
 
-    // VkBootstrap: create vulkan instance
-    vkb::InstanceBuilder builder;
-    builder.set_app_name(window.name.c_str())
-        .enable_extensions(window.extensions)
-        .use_default_debug_messenger()
-        .require_api_version(1, 3, 0);
-    if (window.using_debug_msg()) builder.request_validation_layers();
-    auto instanceBuild = builder.build();
-    if (!instanceBuild) fmt::println("VkBootstrap error: {}", instanceBuild.error().message());
-    vkb::Instance instanceVkb = instanceBuild.value();
+    // VkBootstrap: create vulkan instance while SDL creates the window on the main thread
+    std::future<vkb::Instance> instanceTask = std::async(std::launch::async, [&] {
+        vkb::InstanceBuilder builder;
+        builder.set_app_name(window.name.c_str())
+            .enable_extensions(window.extensions)
+            .use_default_debug_messenger()
+            .require_api_version(1, 3, 0);
+        if (window.using_debug_msg()) builder.request_validation_layers();
+        auto instanceBuild = builder.build();
+        if (!instanceBuild) fmt::println("VkBootstrap error: {}", instanceBuild.error().message());
+        return instanceBuild.value();
+    });
+    window.bHidden = bHeadless;
+    window.create();
+    vkb::Instance instanceVkb = instanceTask.get();
     instance = vk::raii::Instance(context, instanceVkb);
 
     // Vulkan: dynamic dispatcher init 2/3
     VULKAN_HPP_DEFAULT_DISPATCHER.init(*instance);
+    startup.stage("window_instance");
 
     // SDL: create vulkan surface
     window.init(instance, instanceVkb.debug_messenger);
+    startup.stage("surface");
 
     // VkBootstrap: select physical device
     vkb::PhysicalDeviceSelector selector(instanceVkb, *window.surface);
@@ -49,7 +67,20 @@ Engine::Engine() {
     auto deviceSelection = selector.select();
     if (!deviceSelection) fmt::println("VkBootstrap error: {}", deviceSelection.error().message());
     vkb::PhysicalDevice physicalDeviceVkb = deviceSelection.value();
+    // optional: compute writes into swapchain images, anisotropic filtering and bcn textures
+    physicalDeviceVkb.enable_features_if_present(vk::PhysicalDeviceFeatures()
+        .setShaderStorageImageWriteWithoutFormat(true)
+        .setMultiDrawIndirect(true)
+        .setSamplerAnisotropy(true)
+        .setTextureCompressionBC(true));
+    // optional: mesh batches are drawn with one indirect call per pipeline
+    physicalDeviceVkb.enable_extension_features_if_present(vk::PhysicalDeviceVulkan12Features()
+        .setDrawIndirectCount(true));
     physDevice = vk::raii::PhysicalDevice(instance, physicalDeviceVkb);
+    // integrated and software devices skip staging copies
+    renderer.bDirectUploads = Memory::is_unified(physDevice);
+    fmt::println("upload path: {}", renderer.bDirectUploads ? "direct" : "staging");
+    startup.stage("device_select");
 
     // VkBootstrap: create device
     auto deviceBuilder = vkb::DeviceBuilder(physicalDeviceVkb).build();
@@ -59,6 +90,7 @@ Engine::Engine() {
 
     // Vulkan: dynamic dispatcher init 3/3
     VULKAN_HPP_DEFAULT_DISPATCHER.init(*device);
+    startup.stage("device");
 
     // VMA: create allocator
     vma::VulkanFunctions vulkanFuncs(VULKAN_HPP_DEFAULT_DISPATCHER.vkGetInstanceProcAddr, VULKAN_HPP_DEFAULT_DISPATCHER.vkGetDeviceProcAddr);
@@ -70,14 +102,30 @@ Engine::Engine() {
         .setInstance(*instance)
         .setDevice(*device);
     alloc = vma::createAllocatorUnique(allocInfo);
+    startup.stage("vma");
 
     // create command queues
     queues.init(device, deviceVkb);
+    startup.stage("queues");
+
+    // create render pipelines on a worker, overlapping with swapchain and imgui setup
+    reflectTask.get();
+    vk::Extent2D extent = window.size();
+    std::future<void> rendererTask = std::async(std::launch::async, [&] {
+        renderer.init(physDevice, device, alloc, queues, extent);
+    });
     // create swapchain
-    swapchain.init(physDevice, device, window, queues);
-    // create render pipelines
-    renderer.init(device, alloc, queues, vk::Extent2D(window.size()));
+    swapchain.init(physDevice, device, alloc, window, queues);
+    startup.stage("swapchain");
     // initialize imgui backend
     ImGui::backend::init_sdl(window.pWindow);
-    ImGui::backend::init_vulkan(instance, device, physDevice, queues, swapchain.format);
+    // ui is drawn into the cached overlay on the compute present path, else onto the swapchain image
+    vk::Format uiFormat = swapchain.bStorage ? swapchain.overlay.format : swapchain.format;
+    ImGui::backend::init_vulkan(instance, device, physDevice, queues, uiFormat);
+    startup.stage("imgui");
+    // font upload is the only startup submission, so it may use the graphics queue while pipelines compile
+    ImGui::backend::upload_fonts();
+    startup.stage("imgui_fonts");
+    rendererTask.get();
+    startup.stage("renderer");
 }
\ No newline at end of file
@@ -7,12 +7,20 @@
 #include <backends/imgui_impl_vulkan.h>
 #include <vulkan/vulkan_structs.hpp>
 //
+#include <chrono>
+#include <string_view>
+//
 #include "vk_wrappers/imgui_impl.hpp"
 #include "vk_wrappers/queues.hpp"
 
 namespace ImGui {
     namespace backend {
         static vk::raii::DescriptorPool descPool = nullptr;
+        static std::chrono::steady_clock::time_point lastFrame = {};
+        static std::chrono::steady_clock::time_point lastUpdate = {};
+        static float frameTime = 0.0f;
+        static bool bRenderPending = false;
+        static size_t drawDataHash = 0;
         static PFN_vkVoidFunction load_fnc(const char* function_name, void* user_data) {
             const vk::raii::Instance& instance = *reinterpret_cast<vk::raii::Instance*>(user_data);
             return VULKAN_HPP_DEFAULT_DISPATCHER.vkGetInstanceProcAddr(*instance, function_name);
@@ -21,7 +29,7 @@ namespace ImGui {
             ImGui::CreateContext();
             ImGui_ImplSDL3_InitForVulkan(pWindow);
         }
-        void init_vulkan(vk::raii::Instance& instance, vk::raii::Device& device, vk::raii::PhysicalDevice& physDevice, Queues& queues, vk::Format swapchainFormat) {
+        void init_vulkan(vk::raii::Instance& instance, vk::raii::Device& device, vk::raii::PhysicalDevice& physDevice, Queues& queues, vk::Format colorFormat) {
             bool success = ImGui_ImplVulkan_LoadFunctions(&load_fnc, &instance);
             if (!success) fmt::println("sdl failed to load vulkan functions");
 
@@ -57,33 +65,90 @@ namespace ImGui {
             initInfo.UseDynamicRendering = true;
             initInfo.RenderPass = nullptr;
             initInfo.PipelineRenderingCreateInfo = vk::PipelineRenderingCreateInfo()
-                .setColorAttachmentFormats(swapchainFormat);
+                .setColorAttachmentFormats(colorFormat);
             // initInfo.ColorAttachmentFormat = (VkFormat)swapchainFormat;
             initInfo.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
             ImGui_ImplVulkan_Init(&initInfo);
+        }
+        void upload_fonts() {
             ImGui_ImplVulkan_CreateFontsTexture();
         }
         bool process_event(SDL_Event* pEvent) {
             return ImGui_ImplSDL3_ProcessEvent(pEvent);
         }
-        void new_frame() {
+        static size_t hash_draw_data(ImDrawData* pDrawData) {
+            auto hash_bytes = [](size_t seed, const void* pData, size_t size) {
+                size_t hash = std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(pData), size));
+                return seed ^ (hash + 0x9e3779b97f4a7c15 + (seed << 6) + (seed >> 2));
+            };
+            size_t seed = hash_bytes(0, &pDrawData->DisplaySize, sizeof(ImVec2));
+            for (const ImDrawList* pList : pDrawData->CmdLists) {
+                seed = hash_bytes(seed, pList->VtxBuffer.Data, pList->VtxBuffer.size_in_bytes());
+                seed = hash_bytes(seed, pList->IdxBuffer.Data, pList->IdxBuffer.size_in_bytes());
+                for (const ImDrawCmd& drawCmd : pList->CmdBuffer) {
+                    ImTextureID texId = drawCmd.GetTexID();
+                    seed = hash_bytes(seed, &drawCmd.ClipRect, sizeof(ImVec4));
+                    seed = hash_bytes(seed, &texId, sizeof(ImTextureID));
+                    seed = hash_bytes(seed, &drawCmd.ElemCount, sizeof(unsigned int));
+                }
+            }
+            return seed;
+        }
+        float get_frame_time() {
+            return frameTime;
+        }
+        static std::chrono::steady_clock::time_point track_frame_time() {
+            // track render loop frame time (smoothed)
+            auto now = std::chrono::steady_clock::now();
+            float delta = std::chrono::duration<float>(now - lastFrame).count();
+            if (lastFrame != std::chrono::steady_clock::time_point()) frameTime = frameTime == 0.0f ? delta : frameTime * 0.95f + delta * 0.05f;
+            lastFrame = now;
+            return now;
+        }
+        static void begin_frame(std::chrono::steady_clock::time_point now) {
+            lastUpdate = now;
             ImGui_ImplVulkan_NewFrame();
             ImGui_ImplSDL3_NewFrame();
             ImGui::NewFrame();
+            bRenderPending = true;
         }
-        void draw(vk::raii::CommandBuffer& cmd, vk::raii::ImageView& imageView, vk::ImageLayout layout, vk::Extent2D extent) {
+        bool new_frame() {
+            auto now = track_frame_time();
+            // skip ui update entirely when above the update rate cap
+            if (maxUpdateRate > 0.0f && std::chrono::duration<float>(now - lastUpdate).count() < 1.0f / maxUpdateRate) return false;
+            begin_frame(now);
+            return true;
+        }
+        bool new_frame(bool bUpdate) {
+            auto now = track_frame_time();
+            if (bUpdate) begin_frame(now);
+            return bUpdate;
+        }
+        bool render() {
+            if (!bRenderPending) return false;
+            bRenderPending = false;
+            ImGui::Render();
+            size_t hash = hash_draw_data(ImGui::GetDrawData());
+            if (hash == drawDataHash) return false;
+            drawDataHash = hash;
+            return true;
+        }
+        void draw(vk::raii::CommandBuffer& cmd, vk::raii::ImageView& imageView, vk::ImageLayout layout, vk::Extent2D extent, bool bClear) {
+            // draws the draw data of the most recent render(), which may be from a previous frame
+            ImDrawData* pDrawData = ImGui::GetDrawData();
+            if (pDrawData == nullptr) return;
             vk::RenderingAttachmentInfo attachInfo = vk::RenderingAttachmentInfo()
                 .setImageView(*imageView)
                 .setImageLayout(layout)
-                .setLoadOp(vk::AttachmentLoadOp::eLoad)
-                .setStoreOp(vk::AttachmentStoreOp::eStore);
+                .setLoadOp(bClear ? vk::AttachmentLoadOp::eClear : vk::AttachmentLoadOp::eLoad)
+                .setStoreOp(vk::AttachmentStoreOp::eStore)
+                .setClearValue(vk::ClearColorValue(0.0f, 0.0f, 0.0f, 0.0f));
             vk::RenderingInfo renderInfo = vk::RenderingInfo()
                 .setRenderArea(vk::Rect2D({ 0, 0 }, { extent.width, extent.height }))
                 .setLayerCount(1)
                 .setColorAttachments(attachInfo);
             cmd.beginRendering(renderInfo);
-            ImGui::Render();
-            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), *cmd);
+            ImGui_ImplVulkan_RenderDrawData(pDrawData, *cmd);
             cmd.endRendering();
         }
         void shutdown() {
@@ -0,0 +1,77 @@
+#include <vulkan/vulkan_raii.hpp>
+//
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+//
+#include "vk_wrappers/layout_cache.hpp"
+
+namespace {
+    // create infos flattened into words, the device handle comes first
+    using Key = std::vector<uint64_t>;
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t hash = key.size();
+            for (uint64_t word : key) hash ^= std::hash<uint64_t>()(word) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            return hash;
+        }
+    };
+    // pipeline layouts keep their set layouts alive, so the handles in their key cannot be reused
+    struct PipelineLayoutEntry {
+        vk::raii::PipelineLayout layout;
+        std::vector<LayoutCache::SetLayout> setLayouts;
+    };
+
+    // pipelines are initialized from multiple threads
+    std::mutex mutex;
+    std::unordered_map<Key, std::weak_ptr<vk::raii::DescriptorSetLayout>, KeyHash> setLayoutCache;
+    std::unordered_map<Key, std::weak_ptr<vk::raii::PipelineLayout>, KeyHash> pipelineLayoutCache;
+
+    // cached layout, else expired entries are swept so rebuilds do not grow the map (called with the mutex held)
+    template<typename T> std::shared_ptr<T> find_or_sweep(std::unordered_map<Key, std::weak_ptr<T>, KeyHash>& cache, const Key& key) {
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            if (std::shared_ptr<T> cached = it->second.lock()) return cached;
+        }
+        std::erase_if(cache, [](const auto& entry) { return entry.second.expired(); });
+        return nullptr;
+    }
+}
+
+namespace LayoutCache {
+    SetLayout get_set_layout(vk::raii::Device& device, std::span<const vk::DescriptorSetLayoutBinding> bindings) {
+        // binding order does not matter for compatibility
+        std::vector<vk::DescriptorSetLayoutBinding> sorted(bindings.begin(), bindings.end());
+        std::ranges::sort(sorted, {}, &vk::DescriptorSetLayoutBinding::binding);
+        Key key = { (uint64_t)(VkDevice)*device };
+        for (const auto& binding : sorted) {
+            key.insert(key.end(), { binding.binding, (uint64_t)binding.descriptorType, binding.descriptorCount, (uint64_t)(VkShaderStageFlags)binding.stageFlags });
+        }
+
+        std::lock_guard lock(mutex);
+        if (SetLayout setLayout = find_or_sweep(setLayoutCache, key)) return setLayout;
+        vk::DescriptorSetLayoutCreateInfo layoutInfo = vk::DescriptorSetLayoutCreateInfo({}, sorted);
+        SetLayout setLayout = std::make_shared<vk::raii::DescriptorSetLayout>(device.createDescriptorSetLayout(layoutInfo));
+        setLayoutCache[key] = setLayout;
+        return setLayout;
+    }
+    PipelineLayout get_pipeline_layout(vk::raii::Device& device, std::span<const SetLayout> setLayouts, std::span<const vk::PushConstantRange> pushRanges) {
+        Key key = { (uint64_t)(VkDevice)*device, setLayouts.size() };
+        for (const auto& setLayout : setLayouts) key.push_back((uint64_t)(VkDescriptorSetLayout)**setLayout);
+        for (const auto& range : pushRanges) {
+            key.insert(key.end(), { (uint64_t)(VkShaderStageFlags)range.stageFlags, range.offset, range.size });
+        }
+
+        std::lock_guard lock(mutex);
+        if (PipelineLayout layout = find_or_sweep(pipelineLayoutCache, key)) return layout;
+        std::vector<vk::DescriptorSetLayout> handles;
+        for (const auto& setLayout : setLayouts) handles.push_back(**setLayout);
+        vk::PipelineLayoutCreateInfo layoutInfo = vk::PipelineLayoutCreateInfo({}, handles, pushRanges);
+        auto pEntry = std::make_shared<PipelineLayoutEntry>(device.createPipelineLayout(layoutInfo), std::vector(setLayouts.begin(), setLayouts.end()));
+        PipelineLayout layout = PipelineLayout(pEntry, &pEntry->layout);
+        pipelineLayoutCache[key] = layout;
+        return layout;
+    }
+}
@@ -1,6 +1,37 @@
+#include <cstdlib>
+#include <string>
+#include <string_view>
+//
 #include "engine.hpp"
 
-int main() {
-    Engine engine;
+int main(int argc, char** argv) {
+    std::string startupReport, meshPath, texturePath, recordPath, replayPath, timingsPath, capturePath;
+    bool bQuitAfterFirstFrame = false, bHeadless = false, bUncapped = false, bMetrics = false;
+    uint32_t audioPeriod = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--startup-report" && i + 1 < argc) startupReport = argv[++i];
+        else if (arg == "--quit-after-first-frame") bQuitAfterFirstFrame = true;
+        else if (arg == "--mesh" && i + 1 < argc) meshPath = argv[++i];
+        else if (arg == "--texture" && i + 1 < argc) texturePath = argv[++i];
+        else if (arg == "--record" && i + 1 < argc) recordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc) replayPath = argv[++i];
+        else if (arg == "--timings" && i + 1 < argc) timingsPath = argv[++i];
+        else if (arg == "--capture" && i + 1 < argc) capturePath = argv[++i];
+        else if (arg == "--headless") bHeadless = true;
+        else if (arg == "--uncapped") bUncapped = true;
+        else if (arg == "--metrics") bMetrics = true;
+        else if (arg == "--audio-period" && i + 1 < argc) audioPeriod = std::strtoul(argv[++i], nullptr, 10);
+    }
+    Engine engine(meshPath, texturePath, bHeadless);
+    engine.startup.path = startupReport;
+    engine.bQuitAfterFirstFrame = bQuitAfterFirstFrame;
+    engine.recordPath = recordPath;
+    engine.replayPath = replayPath;
+    engine.timingsPath = timingsPath;
+    engine.capturePath = capturePath;
+    engine.bUncapped = bUncapped;
+    engine.bMetrics = bMetrics;
+    if (audioPeriod > 0) engine.audioConfig.periodFrames = audioPeriod;
     engine.run();
-}
\ No newline at end of file
+}
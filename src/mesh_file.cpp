@@ -0,0 +1,73 @@
+#include <fmt/base.h>
+//
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+//
+#include "mesh_file.hpp"
+
+namespace MeshFile {
+    Mapping::~Mapping() {
+        close();
+    }
+    bool Mapping::open(std::string_view path) {
+        close();
+        std::string pathStr = std::string(path);
+        int fd = ::open(pathStr.c_str(), O_RDONLY);
+        if (fd < 0) {
+            fmt::println("could not open mesh: {}", path);
+            return false;
+        }
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(Header)) {
+            fmt::println("invalid mesh file: {}", path);
+            ::close(fd);
+            return false;
+        }
+        // the mapping stays valid after closing the descriptor
+        size = fileStat.st_size;
+        void* pMap = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (pMap == MAP_FAILED) {
+            fmt::println("could not map mesh: {}", path);
+            size = 0;
+            return false;
+        }
+        // blocks are read front to back exactly once while copying into staging memory
+        madvise(pMap, size, MADV_SEQUENTIAL);
+        madvise(pMap, size, MADV_WILLNEED);
+        pData = static_cast<const std::byte*>(pMap);
+
+        // validate header and block bounds, nothing else is parsed
+        const Header& head = header();
+        auto valid_block = [&](Block block, uint64_t expectedSize) {
+            return block.offset % 4 == 0 && block.size == expectedSize && block.offset <= size && block.size <= size - block.offset;
+        };
+        bool bValid = head.magic == magic && head.version == version && head.vertexStride != 0
+            && valid_block(head.lods, (uint64_t)head.lodCount * sizeof(Lod))
+            && valid_block(head.meshlets, (uint64_t)head.meshletCount * sizeof(Meshlet))
+            && valid_block(head.vertices, (uint64_t)head.vertexCount * head.vertexStride)
+            && valid_block(head.indices, (uint64_t)head.indexCount * sizeof(uint32_t));
+        // ranges end up in draw and culling buffers, anything outside the blocks would be read out of bounds on the gpu
+        for (const Lod& lod : bValid ? lods() : std::span<const Lod>()) {
+            bValid &= (uint64_t)lod.firstIndex + lod.indexCount <= head.indexCount;
+        }
+        for (const Meshlet& meshlet : bValid ? meshlets() : std::span<const Meshlet>()) {
+            bValid &= (uint64_t)meshlet.firstIndex + meshlet.indexCount <= head.indexCount && meshlet.vertexCount <= head.vertexCount;
+        }
+        if (!bValid) {
+            fmt::println("invalid mesh file: {} (version {}, expected {})", path, head.version, version);
+            close();
+            return false;
+        }
+        return true;
+    }
+    void Mapping::close() {
+        if (pData == nullptr) return;
+        munmap(const_cast<std::byte*>(pData), size);
+        pData = nullptr;
+        size = 0;
+    }
+}
@@ -0,0 +1,170 @@
+#include <fmt/base.h>
+//
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+//
+#include "metrics.hpp"
+
+namespace Metrics {
+    namespace {
+        struct Entry {
+            std::string name;
+            Type type;
+            Counter counter;
+            Gauge gauge;
+            Histogram histogram;
+        };
+        // deque keeps references stable while metrics are added, the mutex only guards registration and publishing
+        std::mutex registryMutex;
+        std::deque<Entry> registry;
+
+        // histogram bounds are only written on creation, before any reference to the entry is handed out
+        Entry& find_or_add(std::string_view name, Type type, std::span<const double> bounds = {}) {
+            std::lock_guard lock(registryMutex);
+            auto it = std::find_if(registry.begin(), registry.end(), [&](const Entry& entry) { return entry.name == name; });
+            if (it != registry.end()) {
+                if (it->type != type) fmt::println("metric {} registered with different types", name);
+                return *it;
+            }
+            if (registry.size() == maxMetrics) fmt::println("metric {} exceeds the {} published metrics", name, maxMetrics);
+            Entry& entry = registry.emplace_back();
+            entry.name = std::string(name.substr(0, nameSize - 1));
+            entry.type = type;
+            if (type == Type::eHistogram) {
+                // missing bounds fold into an overflow bucket
+                entry.histogram.bounds.fill(msBounds.back());
+                std::copy_n(bounds.begin(), std::min<size_t>(bounds.size(), nBuckets), entry.histogram.bounds.begin());
+            }
+            return entry;
+        }
+
+        struct Publisher {
+            ~Publisher() { stop(); }
+            bool start(std::string_view name, uint32_t intervalMs) {
+                stop();
+                shmName = std::string(name);
+                int fd = shm_open(shmName.c_str(), O_CREAT | O_RDWR, 0644);
+                if (fd < 0) {
+                    fmt::println("could not open shared memory: {}", name);
+                    return false;
+                }
+                if (ftruncate(fd, sizeof(Segment)) != 0) {
+                    fmt::println("could not resize shared memory: {}", name);
+                    ::close(fd);
+                    return false;
+                }
+                void* pMap = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (pMap == MAP_FAILED) {
+                    fmt::println("could not map shared memory: {}", name);
+                    return false;
+                }
+                // a previous instance may have left its contents, keep the sequence increasing for readers still attached
+                pSegment = static_cast<Segment*>(pMap);
+                uint64_t sequence = pSegment->sequence.load(std::memory_order_relaxed);
+                pSegment->sequence.store(sequence | 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                pSegment->magic = magic;
+                pSegment->version = version;
+                pSegment->pid = (uint32_t)getpid();
+                pSegment->nSamples = 0;
+                pSegment->sequence.store((sequence | 1) + 1, std::memory_order_release);
+
+                bStop = false;
+                thread = std::thread([this, intervalMs] {
+                    std::unique_lock lock(mutex);
+                    while (!bStop) {
+                        publish();
+                        cv.wait_for(lock, std::chrono::milliseconds(intervalMs), [this] { return bStop; });
+                    }
+                    publish();
+                });
+                return true;
+            }
+            void stop() {
+                if (thread.joinable()) {
+                    {
+                        std::lock_guard lock(mutex);
+                        bStop = true;
+                    }
+                    cv.notify_one();
+                    thread.join();
+                }
+                if (pSegment != nullptr) {
+                    munmap(pSegment, sizeof(Segment));
+                    shm_unlink(shmName.c_str());
+                    pSegment = nullptr;
+                }
+            }
+            // single writer seqlock: odd sequence while the samples are rewritten
+            void publish() {
+                uint64_t sequence = pSegment->sequence.load(std::memory_order_relaxed);
+                pSegment->sequence.store(sequence + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                {
+                    std::lock_guard lock(registryMutex);
+                    uint32_t nSamples = (uint32_t)std::min<size_t>(registry.size(), maxMetrics);
+                    for (uint32_t i = 0; i < nSamples; i++) write_sample(registry[i], pSegment->samples[i]);
+                    pSegment->nSamples = nSamples;
+                }
+                auto now = std::chrono::system_clock::now().time_since_epoch();
+                pSegment->publishTime = std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+                pSegment->sequence.store(sequence + 2, std::memory_order_release);
+            }
+            static void write_sample(const Entry& entry, Sample& sample) {
+                std::memset(&sample, 0, sizeof(Sample));
+                std::memcpy(sample.name, entry.name.data(), entry.name.size());
+                sample.type = entry.type;
+                switch (entry.type) {
+                    case Type::eCounter:
+                        sample.value = (double)entry.counter.value.load(std::memory_order_relaxed);
+                        break;
+                    case Type::eGauge:
+                        sample.value = entry.gauge.value.load(std::memory_order_relaxed);
+                        break;
+                    case Type::eHistogram:
+                        sample.bounds = entry.histogram.bounds;
+                        for (uint32_t i = 0; i < nBuckets; i++) sample.buckets[i] = entry.histogram.buckets[i].load(std::memory_order_relaxed);
+                        sample.count = entry.histogram.count.load(std::memory_order_relaxed);
+                        sample.value = entry.histogram.sum.load(std::memory_order_relaxed);
+                        break;
+                }
+            }
+
+            std::string shmName;
+            Segment* pSegment = nullptr;
+            std::thread thread;
+            std::mutex mutex;
+            std::condition_variable cv;
+            bool bStop = false;
+        };
+        // declared after the registry so it stops before the registry is destroyed
+        Publisher publisher;
+    }
+
+    Counter& counter(std::string_view name) {
+        return find_or_add(name, Type::eCounter).counter;
+    }
+    Gauge& gauge(std::string_view name) {
+        return find_or_add(name, Type::eGauge).gauge;
+    }
+    Histogram& histogram(std::string_view name, std::span<const double> bounds) {
+        return find_or_add(name, Type::eHistogram, bounds).histogram;
+    }
+
+    bool start_publishing(std::string_view name, uint32_t intervalMs) {
+        return publisher.start(name, intervalMs);
+    }
+    void stop_publishing() {
+        publisher.stop();
+    }
+}
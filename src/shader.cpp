@@ -4,10 +4,12 @@
 #undef VULKAN_HPP_NO_TO_STRING
 #include <vulkan/vulkan_raii.hpp>
 //
+#include <algorithm>
 #include <unordered_map>
 #include <span>
 //
 #include "vk_wrappers/shader.hpp"
+#include "vk_wrappers/layout_cache.hpp"
 CMRC_DECLARE(shaders);
 
 static inline std::pair<const uint32_t*, size_t> read_data(std::string& path) {
@@ -41,6 +43,33 @@ static inline std::vector<SpvReflectDescriptorBinding*> enumDescBindings(const s
     if (result != SPV_REFLECT_RESULT_SUCCESS) fmt::println("shader reflection error: {}", (uint32_t)result);
     return reflDescBinds;
 }
+static inline std::vector<SpvReflectInterfaceVariable*> enumInterfaceVars(const spv_reflect::ShaderModule& reflection, bool bInputs) {
+    uint32_t nVars;
+    SpvReflectResult result;
+    std::vector<SpvReflectInterfaceVariable*> reflVars;
+    if (bInputs) result = reflection.EnumerateInputVariables(&nVars, nullptr);
+    else result = reflection.EnumerateOutputVariables(&nVars, nullptr);
+    if (result != SPV_REFLECT_RESULT_SUCCESS) fmt::println("shader reflection error: {}", (uint32_t)result);
+    reflVars.resize(nVars);
+    if (bInputs) result = reflection.EnumerateInputVariables(&nVars, reflVars.data());
+    else result = reflection.EnumerateOutputVariables(&nVars, reflVars.data());
+    if (result != SPV_REFLECT_RESULT_SUCCESS) fmt::println("shader reflection error: {}", (uint32_t)result);
+    // built-ins (gl_Position, gl_VertexIndex, ...) are not part of the interface layout
+    std::erase_if(reflVars, [](SpvReflectInterfaceVariable* pVar) { return pVar->decoration_flags & SPV_REFLECT_DECORATION_BUILT_IN; });
+    std::sort(reflVars.begin(), reflVars.end(), [](auto* a, auto* b) { return a->location < b->location; });
+    return reflVars;
+}
+static inline std::vector<SpvReflectBlockVariable*> enumPushConstants(const spv_reflect::ShaderModule& reflection) {
+    uint32_t nBlocks;
+    SpvReflectResult result;
+    std::vector<SpvReflectBlockVariable*> reflBlocks;
+    result = reflection.EnumeratePushConstantBlocks(&nBlocks, nullptr);
+    if (result != SPV_REFLECT_RESULT_SUCCESS) fmt::println("shader reflection error: {}", (uint32_t)result);
+    reflBlocks.resize(nBlocks);
+    result = reflection.EnumeratePushConstantBlocks(&nBlocks, reflBlocks.data());
+    if (result != SPV_REFLECT_RESULT_SUCCESS) fmt::println("shader reflection error: {}", (uint32_t)result);
+    return reflBlocks;
+}
 static inline std::vector<vk::DescriptorPoolSize> getPoolSizes(std::span<SpvReflectDescriptorBinding*> reflDescBinds) {
     std::unordered_map<vk::DescriptorType, uint32_t> bindingLookup;
     // tally count of all bind types
@@ -55,28 +84,40 @@ static inline std::vector<vk::DescriptorPoolSize> getPoolSizes(std::span<SpvRefl
 }
 
 Shader::Shader(std::string_view path): path(path) {}
-void Shader::init(vk::raii::Device& device) {
+void Shader::reflect() {
     // reflect spir-v shader contents
     auto [pData, size] = read_data(path);
     const spv_reflect::ShaderModule reflection(size, pData);
+    bReflected = true;
 
-    // stage, sets, bindings
+    // stage, interface variables, sets, bindings
     stage = (vk::ShaderStageFlags)reflection.GetShaderStage();
+    if (stage & vk::ShaderStageFlagBits::eVertex) {
+        // pack all vertex inputs in location order into a single interleaved binding
+        for (const auto& pVar : enumInterfaceVars(reflection, true)) {
+            uint32_t size = pVar->numeric.scalar.width / 8 * std::max(pVar->numeric.vector.component_count, 1u);
+            vertexAttributes.emplace_back(pVar->location, 0, (vk::Format)pVar->format, vertexStride);
+            vertexStride += size;
+        }
+    }
+    if (stage & vk::ShaderStageFlagBits::eFragment) {
+        nColorOutputs = enumInterfaceVars(reflection, false).size();
+    }
+    for (const auto& pBlock : enumPushConstants(reflection)) {
+        fmt::println("{}: push constants {} ({} bytes)", path, pBlock->name != nullptr ? pBlock->name : "", pBlock->size);
+        pushRanges.emplace_back(stage, pBlock->offset, pBlock->size);
+    }
     std::vector<SpvReflectDescriptorSet*> reflDescSets = enumDescSets(reflection);
     std::vector<SpvReflectDescriptorBinding*> reflDescBinds = enumDescBindings(reflection);
     if (reflDescSets.size() == 0) return;
     fmt::println("{}: {} set(s) and {} binding(s)", path, reflDescSets.size(), reflDescBinds.size());
-
-    // create descriptor pool
-    std::vector<vk::DescriptorPoolSize> poolSizes = getPoolSizes(reflDescBinds);
-    vk::DescriptorPoolCreateInfo poolCreateInfo = vk::DescriptorPoolCreateInfo({}, reflDescSets.size(), poolSizes);
-    pool = device.createDescriptorPool(poolCreateInfo);
+    poolSizes = getPoolSizes(reflDescBinds);
 
     // enumerate all sets
-    descSetLayouts.reserve(reflDescSets.size());
+    setBindings.reserve(reflDescSets.size());
     for (const auto& set : reflDescSets) {
         // enumerate all bindings for current set
-        std::vector<vk::DescriptorSetLayoutBinding> bindings(set->binding_count);
+        std::vector<vk::DescriptorSetLayoutBinding>& bindings = setBindings.emplace_back(set->binding_count);
         for (uint32_t i = 0; i < set->binding_count; i++) {
             SpvReflectDescriptorBinding* pBinding = set->bindings[i];
             fmt::println("\tset {} | binding {}: {} {}", 
@@ -89,15 +130,62 @@ void Shader::init(vk::raii::Device& device) {
                 .setStageFlags((vk::ShaderStageFlagBits)reflection.GetShaderStage())
                 .setDescriptorType((vk::DescriptorType)pBinding->descriptor_type);
         }
+    }
+}
+void Shader::merge(const Shader& other) {
+    // bindings used by both stages are shared, others get appended to the matching set
+    stage |= other.stage;
+    if (setBindings.size() < other.setBindings.size()) setBindings.resize(other.setBindings.size());
+    for (uint32_t set = 0; set < other.setBindings.size(); set++) {
+        for (const auto& otherBinding : other.setBindings[set]) {
+            auto binding = std::find_if(setBindings[set].begin(), setBindings[set].end(), [&](const auto& binding) { return binding.binding == otherBinding.binding; });
+            if (binding != setBindings[set].end()) binding->stageFlags |= otherBinding.stageFlags;
+            else setBindings[set].push_back(otherBinding);
+        }
+    }
 
-        // create set layout from all bindings
-        vk::DescriptorSetLayoutCreateInfo descLayoutInfo = vk::DescriptorSetLayoutCreateInfo({}, bindings);
-        descSetLayouts.emplace_back(device.createDescriptorSetLayout(descLayoutInfo));
+    // blocks declared identically in both stages share one range
+    for (const auto& otherRange : other.pushRanges) {
+        auto range = std::find_if(pushRanges.begin(), pushRanges.end(), [&](const auto& range) { return range.offset == otherRange.offset && range.size == otherRange.size; });
+        if (range != pushRanges.end()) range->stageFlags |= otherRange.stageFlags;
+        else pushRanges.push_back(otherRange);
     }
 
-    // allocate desc sets
+    // recount pool sizes over the merged bindings
+    std::unordered_map<vk::DescriptorType, uint32_t> bindingLookup;
+    for (const auto& bindings : setBindings) {
+        for (const auto& binding : bindings) bindingLookup[binding.descriptorType] += binding.descriptorCount;
+    }
+    poolSizes.clear();
+    for (const auto& pair : bindingLookup) poolSizes.emplace_back(pair.first, pair.second);
+}
+void Shader::init(vk::raii::Device& device, uint32_t nInstances) {
+    // reflection may already have happened ahead of device creation
+    if (!bReflected) reflect();
+    if (setBindings.size() == 0) return;
+
+    // create set layouts from all bindings, identical layouts are shared
+    descSetLayouts.reserve(setBindings.size());
+    for (const auto& bindings : setBindings) descSetLayouts.push_back(LayoutCache::get_set_layout(device, bindings));
+    allocate_sets(device, nInstances);
+}
+vk::raii::DescriptorPool Shader::reallocate(vk::raii::Device& device, uint32_t nInstances) {
+    vk::raii::DescriptorPool oldPool = std::move(pool);
+    if (!descSetLayouts.empty()) allocate_sets(device, nInstances);
+    return oldPool;
+}
+void Shader::allocate_sets(vk::raii::Device& device, uint32_t nInstances) {
+    // create descriptor pool
+    std::vector<vk::DescriptorPoolSize> instancePoolSizes = poolSizes;
+    for (auto& poolSize : instancePoolSizes) poolSize.descriptorCount *= nInstances;
+    vk::DescriptorPoolCreateInfo poolCreateInfo = vk::DescriptorPoolCreateInfo({}, setBindings.size() * nInstances, instancePoolSizes);
+    pool = device.createDescriptorPool(poolCreateInfo);
+
+    // allocate desc sets (one full copy per instance)
     std::vector<vk::DescriptorSetLayout> layouts;
-    for (const auto& set : descSetLayouts) layouts.emplace_back(*set);
+    for (uint32_t i = 0; i < nInstances; i++) {
+        for (const auto& set : descSetLayouts) layouts.emplace_back(**set);
+    }
     vk::DescriptorSetAllocateInfo allocInfo = vk::DescriptorSetAllocateInfo()
         .setDescriptorPool(*pool)
         .setSetLayouts(layouts);
@@ -1,21 +1,37 @@
 #include <VkBootstrap.h>
 #include <fmt/base.h>
 //
+#include <cmath>
+//
+#include "metrics.hpp"
 #include "vk_wrappers/image.hpp"
 #include "vk_wrappers/queues.hpp"
 #include "vk_wrappers/swapchain.hpp"
 #include "vk_wrappers/imgui_impl.hpp"
 #include "window.hpp"
 
-void Swapchain::init(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, Window& window, Queues& queues) {
+void Swapchain::init(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc, Window& window, Queues& queues, std::unique_ptr<Swapchain> oldSwapchain) {
     bResizeRequested = false;
+    pOldSwapchain = std::move(oldSwapchain);
+
+    // check if swapchain images can be written to directly by a compute shader
+    vk::Format desiredFormat = vk::Format::eB8G8R8A8Unorm;
+    vk::SurfaceCapabilitiesKHR surfaceCaps = physDevice.getSurfaceCapabilitiesKHR(*window.surface);
+    vk::FormatProperties formatProps = physDevice.getFormatProperties(desiredFormat);
+    bStorage = bStoragePreferred
+        && (surfaceCaps.supportedUsageFlags & vk::ImageUsageFlagBits::eStorage)
+        && (formatProps.optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage)
+        && physDevice.getFeatures().shaderStorageImageWriteWithoutFormat;
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst;
+    if (bStorage) usage |= vk::ImageUsageFlagBits::eStorage;
 
     // VkBoostrap: build swapchain
     vkb::SwapchainBuilder swapchainBuilder(*physDevice, *device, *window.surface);
     swapchainBuilder.set_desired_extent(window.size().width, window.size().height)
-        .set_desired_format(vk::SurfaceFormatKHR(vk::Format::eB8G8R8A8Unorm, vk::ColorSpaceKHR::eSrgbNonlinear))
+        .set_desired_format(vk::SurfaceFormatKHR(desiredFormat, vk::ColorSpaceKHR::eSrgbNonlinear))
         .set_desired_present_mode((VkPresentModeKHR)vk::PresentModeKHR::eFifo)
-        .add_image_usage_flags((VkImageUsageFlags)vk::ImageUsageFlagBits::eTransferDst);
+        .add_image_usage_flags((VkImageUsageFlags)usage)
+        .set_old_swapchain(pOldSwapchain ? (VkSwapchainKHR)*pOldSwapchain->swapchain : VK_NULL_HANDLE);
     auto build = swapchainBuilder.build();
     if (!build) fmt::println("VkBootstrap error: {}", build.error().message());
     vkb::Swapchain swapchainVkb = build.value();
@@ -25,9 +41,13 @@ void Swapchain::init(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& dev
     images = swapchain.getImages();
     std::vector<VkImageView> imageViewsVkb = swapchainVkb.get_image_views().value();
     for (uint32_t i = 0; i < swapchainVkb.image_count; i++) imageViews.emplace_back(device, imageViewsVkb[i]);
+    // the fallback format may not support storage usage
+    if (format != desiredFormat) bStorage = false;
+    fmt::println("swapchain present path: {}", bStorage ? "compute" : "blit");
 
     // Vulkan: create command pools and buffers
     presentationQueue = *queues.graphics.queue;
+    pQueue = &queues.graphics;
     frames.resize(swapchainVkb.image_count);
     for (uint32_t i = 0; i < swapchainVkb.image_count; i++) {
         vk::CommandPoolCreateInfo poolInfo = vk::CommandPoolCreateInfo()
@@ -51,6 +71,25 @@ void Swapchain::init(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& dev
         vk::FenceCreateInfo fenceInfo = vk::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled);
         frames[i].renderFence = device.createFence(fenceInfo);
     }
+
+    // cached ui layer of both present paths, only redrawn when the ui changed
+    vk::ImageUsageFlags overlayUsage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eStorage;
+    overlay = Image(device, alloc, vk::Extent3D(extent, 1), vk::Format::eR8G8B8A8Unorm, overlayUsage, vk::ImageAspectFlagBits::eColor);
+    bOverlayDirty = true;
+
+    // Vulkan: create overlay pipeline of the blit present path
+    if (!bStorage) {
+        overlayPipe.bBlend = true;
+        overlayPipe.init(device, format);
+        overlayPipe.vs.write_descriptor(overlay, 0, 0);
+        return;
+    }
+    // Vulkan: create compute present pipeline with one descriptor instance per swapchain image
+    presentPipe.init(device, swapchainVkb.image_count);
+    for (uint32_t i = 0; i < swapchainVkb.image_count; i++) {
+        presentPipe.cs.write_descriptor(*imageViews[i], 0, 1, i);
+        presentPipe.cs.write_descriptor(overlay, 0, 2, i);
+    }
 }
 void Swapchain::present(vk::raii::Device& device, Image& image, vk::raii::Semaphore& imageSema, uint64_t& semaValue) {
     FrameData& frame = frames[iSyncFrame++ % frames.size()];
@@ -58,19 +97,107 @@ void Swapchain::present(vk::raii::Device& device, Image& image, vk::raii::Semaph
     uint32_t index; // index into swapchain image array
 
     // wait for this frame's fence to be signaled and reset it
+    static Metrics::Histogram& waitTime = Metrics::histogram("present_wait_ms");
+    static Metrics::Histogram& acquireTime = Metrics::histogram("acquire_wait_ms");
+    static Metrics::Counter& submits = Metrics::counter("queue_submits");
     result = vk::Result::eTimeout;
-    while (vk::Result::eTimeout == device.waitForFences(*frame.renderFence, vk::True, UINT64_MAX));
+    {
+        Metrics::ScopedTimer timer(waitTime);
+        while (vk::Result::eTimeout == device.waitForFences(*frame.renderFence, vk::True, UINT64_MAX));
+    }
+    if (bStorage && presentSource != *image.view) {
+        // rebind source image, which only changes alongside renderer rebuilds
+        // the descriptors may still be read by earlier presents of this swapchain, not by any other work
+        std::vector<vk::Fence> fences;
+        for (FrameData& other : frames) fences.push_back(*other.renderFence);
+        while (vk::Result::eTimeout == device.waitForFences(fences, vk::True, UINT64_MAX));
+        for (uint32_t i = 0; i < images.size(); i++) presentPipe.cs.write_descriptor(image, 0, 0, i);
+        presentSource = *image.view;
+    }
     device.resetFences({ *frame.renderFence });
 
     // acquire image from swapchain
     result = vk::Result::eTimeout;
-    while (vk::Result::eTimeout == result) std::tie(result, index) = swapchain.acquireNextImage(UINT64_MAX, *frame.swapAcquireSema);
+    {
+        Metrics::ScopedTimer timer(acquireTime);
+        while (vk::Result::eTimeout == result) std::tie(result, index) = swapchain.acquireNextImage(UINT64_MAX, *frame.swapAcquireSema);
+    }
 
     // restart command buffer
     vk::raii::CommandBuffer& cmd = frame.commandBuffer;
     vk::CommandBufferBeginInfo cmdBeginInfo = vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
     cmd.begin(cmdBeginInfo);
 
+    // transfer input image contents to swapchain image, alongside the ui
+    if (ImGui::backend::render()) bOverlayDirty = true;
+    if (bStorage) convert(cmd, image, index);
+    else blit(cmd, image, index);
+
+    // finalize swapchain image
+    vk::ImageMemoryBarrier2 imageBarrier = vk::ImageMemoryBarrier2()
+        .setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+        .setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite)
+        .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+        .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead)
+        .setOldLayout(bStorage ? vk::ImageLayout::eGeneral : vk::ImageLayout::eAttachmentOptimal)
+        .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
+        .setSubresourceRange(vk::ImageSubresourceRange(
+            vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1))
+        .setImage(images[index]);
+    vk::DependencyInfo depInfo = vk::DependencyInfo()
+        .setImageMemoryBarriers(imageBarrier);
+    cmd.pipelineBarrier2(depInfo);
+    cmd.end();
+
+    // submit command buffer to graphics queue
+    std::array<vk::SemaphoreSubmitInfo, 2> waitInfos = {
+        vk::SemaphoreSubmitInfo()
+            .setSemaphore(*imageSema)
+            .setStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+            .setValue(semaValue),
+        vk::SemaphoreSubmitInfo()
+            .setSemaphore(*frame.swapAcquireSema)
+            .setStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+    };
+    std::array<vk::SemaphoreSubmitInfo, 3> signInfos = {
+        vk::SemaphoreSubmitInfo()
+            .setSemaphore(*imageSema)
+            .setStageMask(bStorage ? vk::PipelineStageFlagBits2::eComputeShader : vk::PipelineStageFlagBits2::eTransfer)
+            .setValue(++semaValue),
+        vk::SemaphoreSubmitInfo()
+            .setSemaphore(*frame.swapWriteSema)
+            .setStageMask(vk::PipelineStageFlagBits2::eAllCommands),
+        // retired resources, including replaced swapchains, are tracked on the queue's timeline
+        vk::SemaphoreSubmitInfo()
+            .setSemaphore(*pQueue->timeline)
+            .setStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+            .setValue(++pQueue->timelineValue)
+    };
+    vk::CommandBufferSubmitInfo cmdSubmitInfo(*cmd);
+    vk::SubmitInfo2 submitInfo = vk::SubmitInfo2()
+        .setWaitSemaphoreInfos(waitInfos)
+        .setSignalSemaphoreInfos(signInfos)
+        .setCommandBufferInfos(cmdSubmitInfo);
+    presentationQueue.submit2(submitInfo, *frame.renderFence);
+    submits.add();
+
+    // present swapchain image
+    vk::PresentInfoKHR presentInfo = vk::PresentInfoKHR()
+        .setSwapchains(*swapchain)
+        .setWaitSemaphores(*frame.swapWriteSema)
+        .setImageIndices(index);
+    try {
+        result = presentationQueue.presentKHR(presentInfo);
+        // presents execute in queue order, the replaced swapchain's last present is done by the time this one is
+        // the next submission's timeline value covers both
+        if (pOldSwapchain) pQueue->retire(std::move(pOldSwapchain));
+    }
+    catch (vk::OutOfDateKHRError) { bResizeRequested = true; }
+}
+void Swapchain::blit(vk::raii::CommandBuffer& cmd, Image& image, uint32_t index) {
+    // refresh cached ui layer if needed
+    draw_overlay(cmd, vk::PipelineStageFlagBits2::eFragmentShader);
+
     // transition image layouts for upcoming blit
     image.transition_layout_w_to_r(cmd, vk::ImageLayout::eTransferSrcOptimal,
         vk::PipelineStageFlagBits2::eAllCommands, vk::PipelineStageFlagBits2::eBlit);
@@ -102,13 +229,13 @@ void Swapchain::present(vk::raii::Device& device, Image& image, vk::raii::Semaph
         .setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
         .setFilter(vk::Filter::eLinear);
     cmd.blitImage2(blitInfo);
-    
-    // draw ImGui UI directly onto swapchain image
+
+    // composite cached ui layer onto swapchain image
     imageBarrier = vk::ImageMemoryBarrier2()
         .setSrcStageMask(vk::PipelineStageFlagBits2::eBlit)
-        .setSrcAccessMask(vk::AccessFlagBits2::eMemoryRead)
+        .setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite)
         .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
-        .setDstAccessMask(vk::AccessFlagBits2::eMemoryWrite)
+        .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite)
         .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
         .setNewLayout(vk::ImageLayout::eAttachmentOptimal)
         .setSubresourceRange(vk::ImageSubresourceRange(
@@ -117,55 +244,55 @@ void Swapchain::present(vk::raii::Device& device, Image& image, vk::raii::Semaph
     depInfo = vk::DependencyInfo()
         .setImageMemoryBarriers(imageBarrier);
     cmd.pipelineBarrier2(depInfo);
-    ImGui::backend::draw(cmd, imageViews[index], vk::ImageLayout::eAttachmentOptimal, extent);
+    vk::RenderingAttachmentInfo attachInfo = vk::RenderingAttachmentInfo()
+        .setImageView(*imageViews[index])
+        .setImageLayout(vk::ImageLayout::eAttachmentOptimal)
+        .setLoadOp(vk::AttachmentLoadOp::eLoad)
+        .setStoreOp(vk::AttachmentStoreOp::eStore);
+    vk::RenderingInfo renderInfo = vk::RenderingInfo()
+        .setRenderArea(vk::Rect2D({ 0, 0 }, extent))
+        .setLayerCount(1)
+        .setColorAttachments(attachInfo);
+    cmd.beginRendering(renderInfo);
+    BindState state;
+    overlayPipe.bind(cmd, state, extent);
+    cmd.setCullMode(vk::CullModeFlagBits::eNone); // fullscreen triangle, winding does not matter
+    cmd.draw(3, 1, 0, 0);
+    cmd.endRendering();
+}
+void Swapchain::draw_overlay(vk::raii::CommandBuffer& cmd, vk::PipelineStageFlags2 readStage) {
+    // only re-render the ui layer when its draw data changed
+    if (!bOverlayDirty) return;
+    bOverlayDirty = false;
+    overlay.transition_layout_r_to_w(cmd, vk::ImageLayout::eAttachmentOptimal,
+        readStage, vk::PipelineStageFlagBits2::eColorAttachmentOutput);
+    ImGui::backend::draw(cmd, overlay.view, vk::ImageLayout::eAttachmentOptimal, extent, true);
+    overlay.transition_layout_w_to_r(cmd, vk::ImageLayout::eGeneral,
+        vk::PipelineStageFlagBits2::eColorAttachmentOutput, readStage);
+}
+void Swapchain::convert(vk::raii::CommandBuffer& cmd, Image& image, uint32_t index) {
+    // refresh cached ui layer if needed
+    draw_overlay(cmd, vk::PipelineStageFlagBits2::eComputeShader);
 
-    // finalize swapchain image
-    imageBarrier = vk::ImageMemoryBarrier2()
+    // transition image layouts for upcoming compute pass
+    image.transition_layout_w_to_r(cmd, vk::ImageLayout::eGeneral,
+        vk::PipelineStageFlagBits2::eAllCommands, vk::PipelineStageFlagBits2::eComputeShader);
+    vk::ImageMemoryBarrier2 imageBarrier = vk::ImageMemoryBarrier2()
         .setSrcStageMask(vk::PipelineStageFlagBits2::eAllCommands)
-        .setSrcAccessMask(vk::AccessFlagBits2::eMemoryWrite)
-        .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
-        .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead)
-        .setOldLayout(vk::ImageLayout::eAttachmentOptimal)
-        .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
+        .setSrcAccessMask(vk::AccessFlagBits2::eMemoryRead)
+        .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+        .setDstAccessMask(vk::AccessFlagBits2::eMemoryWrite)
+        .setOldLayout(vk::ImageLayout::eUndefined)
+        .setNewLayout(vk::ImageLayout::eGeneral)
         .setSubresourceRange(vk::ImageSubresourceRange(
             vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1))
         .setImage(images[index]);
-    depInfo = vk::DependencyInfo()
+    vk::DependencyInfo depInfo = vk::DependencyInfo()
         .setImageMemoryBarriers(imageBarrier);
     cmd.pipelineBarrier2(depInfo);
-    cmd.end();
-
-    // submit command buffer to graphics queue
-    std::array<vk::SemaphoreSubmitInfo, 2> waitInfos = {
-        vk::SemaphoreSubmitInfo()
-            .setSemaphore(*imageSema)
-            .setStageMask(vk::PipelineStageFlagBits2::eAllCommands)
-            .setValue(semaValue),
-        vk::SemaphoreSubmitInfo()
-            .setSemaphore(*frame.swapAcquireSema)
-            .setStageMask(vk::PipelineStageFlagBits2::eAllCommands)
-    };
-    std::array<vk::SemaphoreSubmitInfo, 2> signInfos = {
-        vk::SemaphoreSubmitInfo()
-            .setSemaphore(*imageSema)
-            .setStageMask(vk::PipelineStageFlagBits2::eTransfer)
-            .setValue(++semaValue),
-        vk::SemaphoreSubmitInfo()
-            .setSemaphore(*frame.swapWriteSema)
-            .setStageMask(vk::PipelineStageFlagBits2::eAllCommands)
-    };
-    vk::CommandBufferSubmitInfo cmdSubmitInfo(*cmd);
-    vk::SubmitInfo2 submitInfo = vk::SubmitInfo2()
-        .setWaitSemaphoreInfos(waitInfos)
-        .setSignalSemaphoreInfos(signInfos)
-        .setCommandBufferInfos(cmdSubmitInfo);
-    presentationQueue.submit2(submitInfo, *frame.renderFence);
 
-    // present swapchain image
-    vk::PresentInfoKHR presentInfo = vk::PresentInfoKHR()
-        .setSwapchains(*swapchain)
-        .setWaitSemaphores(*frame.swapWriteSema)
-        .setImageIndices(index);
-    try { result = presentationQueue.presentKHR(presentInfo); }
-    catch (vk::OutOfDateKHRError) { bResizeRequested = true; }
+    // convert input image and composite ui while writing straight into the swapchain image
+    // the overlay is drawn by imgui, which binds outside of any tracker
+    BindState state;
+    presentPipe.execute(cmd, state, std::ceil(extent.width / 16.0f), std::ceil(extent.height / 16.0f), 1, index);
 }
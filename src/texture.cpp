@@ -0,0 +1,326 @@
+#include <fmt/base.h>
+#undef VULKAN_HPP_NO_TO_STRING
+#include <vulkan/vulkan_raii.hpp>
+//
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <string>
+//
+#include "vk_wrappers/texture.hpp"
+
+namespace {
+    // ktx2 header directly following the 12 byte identifier
+    struct Ktx2Header {
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth, pixelHeight, pixelDepth;
+        uint32_t layerCount, faceCount, levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset, dfdByteLength;
+        uint32_t kvdByteOffset, kvdByteLength;
+        uint32_t sgdByteOffset[2], sgdByteLength[2]; // unaligned uint64 in the file, not used by the loader
+    };
+    struct Ktx2Level {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+    static_assert(sizeof(Ktx2Header) == 68 && sizeof(Ktx2Level) == 24);
+    constexpr std::array<uint8_t, 12> ktx2Identifier = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    // level data in staging memory, aligned for every supported texel block size
+    constexpr vk::DeviceSize levelAlignment = 16;
+
+    // bytes per texel block and block edge length, 0 bytes for formats the loader does not handle
+    struct BlockInfo {
+        uint32_t nBytes;
+        uint32_t dim;
+    };
+    BlockInfo block_info(vk::Format format) {
+        switch (format) {
+            case vk::Format::eR8Unorm: return { 1, 1 };
+            case vk::Format::eR8G8Unorm: return { 2, 1 };
+            case vk::Format::eR8G8B8A8Unorm: case vk::Format::eR8G8B8A8Srgb:
+            case vk::Format::eB8G8R8A8Unorm: case vk::Format::eB8G8R8A8Srgb: return { 4, 1 };
+            case vk::Format::eR16G16B16A16Sfloat: return { 8, 1 };
+            case vk::Format::eR32G32B32A32Sfloat: return { 16, 1 };
+            case vk::Format::eBc1RgbUnormBlock: case vk::Format::eBc1RgbSrgbBlock:
+            case vk::Format::eBc1RgbaUnormBlock: case vk::Format::eBc1RgbaSrgbBlock:
+            case vk::Format::eBc4UnormBlock: case vk::Format::eBc4SnormBlock: return { 8, 4 };
+            case vk::Format::eBc2UnormBlock: case vk::Format::eBc2SrgbBlock:
+            case vk::Format::eBc3UnormBlock: case vk::Format::eBc3SrgbBlock:
+            case vk::Format::eBc5UnormBlock: case vk::Format::eBc5SnormBlock:
+            case vk::Format::eBc6HUfloatBlock: case vk::Format::eBc6HSfloatBlock:
+            case vk::Format::eBc7UnormBlock: case vk::Format::eBc7SrgbBlock: return { 16, 4 };
+            default: return { 0, 0 };
+        }
+    }
+    // rgba8 format a bcn format is decoded to on the cpu, eUndefined if there is no decoder
+    vk::Format decoded_format(vk::Format format) {
+        switch (format) {
+            case vk::Format::eBc1RgbUnormBlock: case vk::Format::eBc1RgbaUnormBlock:
+            case vk::Format::eBc2UnormBlock: case vk::Format::eBc3UnormBlock:
+            case vk::Format::eBc4UnormBlock: case vk::Format::eBc5UnormBlock: return vk::Format::eR8G8B8A8Unorm;
+            case vk::Format::eBc1RgbSrgbBlock: case vk::Format::eBc1RgbaSrgbBlock:
+            case vk::Format::eBc2SrgbBlock: case vk::Format::eBc3SrgbBlock: return vk::Format::eR8G8B8A8Srgb;
+            default: return vk::Format::eUndefined;
+        }
+    }
+
+    // bc1 color endpoints and 2 bit indices, bc2/bc3 always use the 4 color mode
+    void decode_color(const uint8_t* pBlock, bool bFourColor, std::array<std::array<uint8_t, 4>, 16>& texels) {
+        uint16_t c0 = pBlock[0] | pBlock[1] << 8;
+        uint16_t c1 = pBlock[2] | pBlock[3] << 8;
+        auto expand = [](uint16_t c) {
+            uint32_t r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+            return std::array<uint32_t, 3>{ r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2 };
+        };
+        std::array<uint32_t, 3> e0 = expand(c0), e1 = expand(c1);
+        std::array<std::array<uint8_t, 4>, 4> palette;
+        for (uint32_t i = 0; i < 3; i++) {
+            palette[0][i] = e0[i];
+            palette[1][i] = e1[i];
+            if (bFourColor || c0 > c1) {
+                palette[2][i] = (2 * e0[i] + e1[i]) / 3;
+                palette[3][i] = (e0[i] + 2 * e1[i]) / 3;
+            }
+            else {
+                palette[2][i] = (e0[i] + e1[i]) / 2;
+                palette[3][i] = 0;
+            }
+        }
+        palette[0][3] = palette[1][3] = palette[2][3] = 255;
+        palette[3][3] = (bFourColor || c0 > c1) ? 255 : 0;
+        uint32_t indices = pBlock[4] | pBlock[5] << 8 | pBlock[6] << 16 | (uint32_t)pBlock[7] << 24;
+        for (uint32_t i = 0; i < 16; i++) texels[i] = palette[(indices >> (2 * i)) & 3];
+    }
+    // bc3 alpha / bc4 / bc5 channel: two endpoints and 3 bit indices
+    void decode_channel(const uint8_t* pBlock, uint32_t channel, std::array<std::array<uint8_t, 4>, 16>& texels) {
+        uint32_t a0 = pBlock[0], a1 = pBlock[1];
+        std::array<uint8_t, 8> palette = { (uint8_t)a0, (uint8_t)a1 };
+        if (a0 > a1) {
+            for (uint32_t i = 1; i < 7; i++) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        }
+        else {
+            for (uint32_t i = 1; i < 5; i++) palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+        uint64_t indices = 0;
+        for (uint32_t i = 0; i < 6; i++) indices |= (uint64_t)pBlock[2 + i] << (8 * i);
+        for (uint32_t i = 0; i < 16; i++) texels[i][channel] = palette[(indices >> (3 * i)) & 7];
+    }
+    // decodes one level of bc1-bc5 blocks into tightly packed rgba8
+    void decode_level(vk::Format format, const uint8_t* pSrc, uint8_t* pDst, uint32_t width, uint32_t height) {
+        BlockInfo info = block_info(format);
+        uint32_t nBlocksX = (width + 3) / 4, nBlocksY = (height + 3) / 4;
+        std::array<std::array<uint8_t, 4>, 16> texels;
+        for (uint32_t by = 0; by < nBlocksY; by++) {
+            for (uint32_t bx = 0; bx < nBlocksX; bx++, pSrc += info.nBytes) {
+                switch (format) {
+                    case vk::Format::eBc1RgbUnormBlock: case vk::Format::eBc1RgbSrgbBlock:
+                        decode_color(pSrc, false, texels);
+                        for (auto& texel : texels) texel[3] = 255;
+                        break;
+                    case vk::Format::eBc1RgbaUnormBlock: case vk::Format::eBc1RgbaSrgbBlock:
+                        decode_color(pSrc, false, texels);
+                        break;
+                    case vk::Format::eBc2UnormBlock: case vk::Format::eBc2SrgbBlock:
+                        decode_color(pSrc + 8, true, texels);
+                        for (uint32_t i = 0; i < 16; i++) texels[i][3] = ((pSrc[i / 2] >> (4 * (i % 2))) & 15) * 17;
+                        break;
+                    case vk::Format::eBc3UnormBlock: case vk::Format::eBc3SrgbBlock:
+                        decode_color(pSrc + 8, true, texels);
+                        decode_channel(pSrc, 3, texels);
+                        break;
+                    case vk::Format::eBc4UnormBlock:
+                        texels.fill({ 0, 0, 0, 255 });
+                        decode_channel(pSrc, 0, texels);
+                        break;
+                    case vk::Format::eBc5UnormBlock:
+                        texels.fill({ 0, 0, 0, 255 });
+                        decode_channel(pSrc, 0, texels);
+                        decode_channel(pSrc + 8, 1, texels);
+                        break;
+                    default: return;
+                }
+                // blocks on the right and bottom edge may extend past the level
+                for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+                    for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++) {
+                        std::memcpy(pDst + 4 * ((size_t)(by * 4 + y) * width + bx * 4 + x), texels[y * 4 + x].data(), 4);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool Texture::load_rgba(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc,
+        std::span<const uint8_t> pixels, vk::Extent2D extent, vk::Format format) {
+    if (pixels.size() != (size_t)extent.width * extent.height * 4) {
+        fmt::println("texture size mismatch: {} bytes for {}x{}", pixels.size(), extent.width, extent.height);
+        return false;
+    }
+    std::byte* pStaging = create(physDevice, device, alloc, format, extent, 0, pixels.size());
+    std::memcpy(pStaging, pixels.data(), pixels.size());
+    copies = { vk::BufferImageCopy(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1), {}, vk::Extent3D(extent, 1)) };
+    alloc->flushAllocation(*staging.allocation, 0, vk::WholeSize);
+    bUploadPending = true;
+    return true;
+}
+
+bool Texture::load_ktx2(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc, std::string_view path) {
+    std::ifstream file(std::string(path), std::ios::binary);
+    std::array<uint8_t, 12> identifier;
+    Ktx2Header header;
+    file.read(reinterpret_cast<char*>(identifier.data()), identifier.size());
+    file.read(reinterpret_cast<char*>(&header), sizeof(Ktx2Header));
+    if (!file || identifier != ktx2Identifier) {
+        fmt::println("invalid ktx2 file: {}", path);
+        return false;
+    }
+    vk::Format format = (vk::Format)header.vkFormat;
+    BlockInfo info = block_info(format);
+    if (info.nBytes == 0 || header.supercompressionScheme != 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+        fmt::println("unsupported ktx2 file: {} ({}, supercompression {})", path, vk::to_string(format), header.supercompressionScheme);
+        return false;
+    }
+    // levelCount 0 stores only level 0 and asks the loader to generate the rest
+    uint32_t nLevels = std::max(header.levelCount, 1u);
+    uint32_t maxDim = physDevice.getProperties().limits.maxImageDimension2D;
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelWidth > maxDim || header.pixelHeight > maxDim
+        || nLevels > Image::mip_count(vk::Extent3D(header.pixelWidth, header.pixelHeight, 1))) {
+        fmt::println("invalid ktx2 file: {} ({}x{}, {} levels)", path, header.pixelWidth, header.pixelHeight, header.levelCount);
+        return false;
+    }
+    std::vector<Ktx2Level> levels(nLevels);
+    file.read(reinterpret_cast<char*>(levels.data()), nLevels * sizeof(Ktx2Level));
+    if (!file) {
+        fmt::println("invalid ktx2 file: {}", path);
+        return false;
+    }
+
+    // compressed formats without sampling support fall back to a cpu decode
+    vk::Format uploadFormat = format;
+    vk::FormatFeatureFlags features = physDevice.getFormatProperties(format).optimalTilingFeatures;
+    if (!(features & vk::FormatFeatureFlagBits::eSampledImage)) {
+        uploadFormat = decoded_format(format);
+        if (uploadFormat == vk::Format::eUndefined) {
+            fmt::println("{} is not supported by the device: {}", vk::to_string(format), path);
+            return false;
+        }
+        fmt::println("{} is not supported by the device, decoding {} to {}", vk::to_string(format), path, vk::to_string(uploadFormat));
+    }
+    bool bDecode = uploadFormat != format;
+    // mips are generated with blits, which cannot write block compressed formats, those keep the single level
+    bool bGenerateLevels = header.levelCount == 0 && block_info(uploadFormat).dim == 1;
+
+    // level data is read straight into staging memory, level 0 is the largest
+    // without supercompression a level holds exactly its blocks, any other length is rejected before sizing reads
+    vk::Extent2D extent = vk::Extent2D(header.pixelWidth, header.pixelHeight);
+    std::vector<vk::DeviceSize> offsets(nLevels);
+    std::vector<vk::DeviceSize> sizes(nLevels);
+    vk::DeviceSize stagingSize = 0;
+    for (uint32_t level = 0; level < nLevels; level++) {
+        uint32_t width = std::max(extent.width >> level, 1u), height = std::max(extent.height >> level, 1u);
+        vk::DeviceSize levelSize = (vk::DeviceSize)((width + info.dim - 1) / info.dim) * ((height + info.dim - 1) / info.dim) * info.nBytes;
+        if (levels[level].byteLength != levelSize) {
+            fmt::println("invalid ktx2 file: {} (level {} has {} bytes, expected {})", path, level, levels[level].byteLength, levelSize);
+            return false;
+        }
+        sizes[level] = levelSize;
+        offsets[level] = stagingSize;
+        stagingSize += bDecode ? (vk::DeviceSize)width * height * 4 : levelSize;
+        stagingSize = (stagingSize + levelAlignment - 1) & ~(levelAlignment - 1);
+    }
+
+    // unified memory: a single level is written straight into a linear image, rows follow the image's pitch
+    vk::SubresourceLayout layout;
+    std::byte* pImage = bDirect && nLevels == 1 && !bGenerateLevels ? create_linear(physDevice, device, alloc, uploadFormat, extent, layout) : nullptr;
+    if (pImage != nullptr) {
+        BlockInfo uploadInfo = block_info(uploadFormat);
+        size_t rowSize = (size_t)((extent.width + uploadInfo.dim - 1) / uploadInfo.dim) * uploadInfo.nBytes;
+        size_t nRows = (extent.height + uploadInfo.dim - 1) / uploadInfo.dim;
+        std::vector<uint8_t> texels(sizes[0]);
+        file.seekg(levels[0].byteOffset);
+        file.read(reinterpret_cast<char*>(texels.data()), texels.size());
+        if (!file) {
+            fmt::println("invalid ktx2 file: {} (unexpected end of file)", path);
+            return false;
+        }
+        if (bDecode) {
+            std::vector<uint8_t> decoded(rowSize * nRows);
+            decode_level(format, texels.data(), decoded.data(), extent.width, extent.height);
+            texels = std::move(decoded);
+        }
+        for (size_t row = 0; row < nRows; row++) {
+            std::memcpy(pImage + layout.offset + row * layout.rowPitch, texels.data() + row * rowSize, rowSize);
+        }
+        alloc->flushAllocation(*image.allocation, 0, vk::WholeSize);
+        bUploadPending = true;
+        return true;
+    }
+    std::byte* pStaging = create(physDevice, device, alloc, uploadFormat, extent, bGenerateLevels ? 0 : nLevels, stagingSize);
+    std::vector<uint8_t> compressed;
+    copies.clear();
+    for (uint32_t level = 0; level < nLevels; level++) {
+        uint32_t width = std::max(extent.width >> level, 1u), height = std::max(extent.height >> level, 1u);
+        file.seekg(levels[level].byteOffset);
+        if (bDecode) {
+            compressed.resize(sizes[level]);
+            file.read(reinterpret_cast<char*>(compressed.data()), compressed.size());
+            decode_level(format, compressed.data(), reinterpret_cast<uint8_t*>(pStaging + offsets[level]), width, height);
+        }
+        else file.read(reinterpret_cast<char*>(pStaging + offsets[level]), sizes[level]);
+        copies.emplace_back(offsets[level], 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1), vk::Offset3D(), vk::Extent3D(width, height, 1));
+    }
+    if (!file) {
+        fmt::println("invalid ktx2 file: {} (unexpected end of file)", path);
+        return false;
+    }
+    alloc->flushAllocation(*staging.allocation, 0, vk::WholeSize);
+    bUploadPending = true;
+    return true;
+}
+
+std::byte* Texture::create(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc,
+        vk::Format format, vk::Extent2D extent, uint32_t nLevels, vk::DeviceSize stagingSize) {
+    // mip chains are generated with blits, which needs blit support for the format (and linear filtering for quality)
+    vk::FormatFeatureFlags features = physDevice.getFormatProperties(format).optimalTilingFeatures;
+    bGenerateMips = nLevels == 0;
+    if (bGenerateMips && !(features & vk::FormatFeatureFlagBits::eBlitSrc && features & vk::FormatFeatureFlagBits::eBlitDst)) {
+        fmt::println("{} does not support blits, texture is created without mips", vk::to_string(format));
+        bGenerateMips = false;
+        nLevels = 1;
+    }
+    if (bGenerateMips) nLevels = Image::mip_count(vk::Extent3D(extent, 1));
+    bLinear = false;
+    mipFilter = features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear ? vk::Filter::eLinear : vk::Filter::eNearest;
+
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+    if (bGenerateMips) usage |= vk::ImageUsageFlagBits::eTransferSrc;
+    image = Image(device, alloc, vk::Extent3D(extent, 1), format, usage, vk::ImageAspectFlagBits::eColor, nLevels);
+    staging = Buffer(alloc, stagingSize, vk::BufferUsageFlagBits::eTransferSrc,
+        vma::AllocationCreateFlagBits::eHostAccessSequentialWrite | vma::AllocationCreateFlagBits::eMapped);
+    return static_cast<std::byte*>(staging.pMapped);
+}
+
+std::byte* Texture::create_linear(vk::raii::PhysicalDevice& physDevice, vk::raii::Device& device, vma::UniqueAllocator& alloc,
+        vk::Format format, vk::Extent2D extent, vk::SubresourceLayout& layout) {
+    // sampling with linear tiling is optional, filtering included
+    vk::FormatFeatureFlags features = physDevice.getFormatProperties(format).linearTilingFeatures;
+    if (!(features & vk::FormatFeatureFlagBits::eSampledImage && features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) return nullptr;
+    try {
+        vk::ImageFormatProperties props = physDevice.getImageFormatProperties(format, vk::ImageType::e2D, vk::ImageTiling::eLinear, vk::ImageUsageFlagBits::eSampled);
+        if (extent.width > props.maxExtent.width || extent.height > props.maxExtent.height) return nullptr;
+    }
+    catch (vk::FormatNotSupportedError) { return nullptr; }
+
+    image = Image::linear(device, alloc, vk::Extent3D(extent, 1), format, vk::ImageUsageFlagBits::eSampled, layout);
+    staging = {};
+    copies.clear();
+    bGenerateMips = false;
+    bLinear = true;
+    return static_cast<std::byte*>(image.pMapped);
+}
@@ -19,13 +19,12 @@
 #define MSG_UTILS_REQUESTED 0
 #endif
 
-Window::Window(int width, int height) {
+Window::Window(int width, int height): initialWidth(width), initialHeight(height) {
     // SDL: init subsystem
     if (SDL_InitSubSystem(SDL_InitFlags::SDL_INIT_VIDEO)) fmt::println("{}", SDL_GetError());
 
-    // SDL: create window
-    pWindow = SDL_CreateWindow(name.c_str(), width, height, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
-    if (pWindow == nullptr) fmt::println("{}", SDL_GetError());
+    // SDL: load vulkan library ahead of window creation to allow early instance creation
+    if (SDL_Vulkan_LoadLibrary(nullptr)) fmt::println("{}", SDL_GetError());
     
     // SDL: query required extensions
     uint32_t nExtensions;
@@ -34,6 +33,11 @@ Window::Window(int width, int height) {
     extensions.resize(nExtensions);
     for (uint32_t i = 0; i < nExtensions; i++) extensions[i] = pExtensions[i];
 }
+void Window::create() {
+    // SDL: create window
+    pWindow = SDL_CreateWindow(name.c_str(), initialWidth, initialHeight, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE | (bHidden ? SDL_WINDOW_HIDDEN : 0));
+    if (pWindow == nullptr) fmt::println("{}", SDL_GetError());
+}
 Window::~Window() {
     SDL_Quit();
 }
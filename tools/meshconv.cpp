@@ -0,0 +1,348 @@
+#include <fmt/base.h>
+//
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+//
+#include "mesh_file.hpp"
+
+// offline converter from text/cad formats into the binary mesh format loaded by MeshFile::Mapping
+// usage: vulkan-renderer-meshconv <input.obj|input.stl> <output.mesh> [--lods N]
+// lods are generated by vertex clustering, meshlets are greedy clusters of consecutive lod 0 triangles
+
+using Vec3 = std::array<float, 3>;
+static Vec3 operator+(Vec3 a, Vec3 b) { return { a[0] + b[0], a[1] + b[1], a[2] + b[2] }; }
+static Vec3 operator-(Vec3 a, Vec3 b) { return { a[0] - b[0], a[1] - b[1], a[2] - b[2] }; }
+static Vec3 operator*(Vec3 a, float s) { return { a[0] * s, a[1] * s, a[2] * s }; }
+static Vec3 cross(Vec3 a, Vec3 b) { return { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] }; }
+static float length(Vec3 a) { return std::sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]); }
+static Vec3 normalize(Vec3 a) {
+    float len = length(a);
+    return len > 0.0f ? a * (1.0f / len) : Vec3{ 0.0f, 0.0f, 1.0f };
+}
+
+// matches Vertex in batch.hpp
+struct Vertex {
+    Vec3 position;
+    Vec3 normal;
+};
+static_assert(sizeof(Vertex) == 24);
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+struct Sphere {
+    Vec3 center;
+    float radius;
+};
+
+// bounding sphere around the center of the bounding box
+template<typename Indices> static Sphere bounding_sphere(const std::vector<Vertex>& vertices, const Indices& indices) {
+    Vec3 min = { INFINITY, INFINITY, INFINITY }, max = { -INFINITY, -INFINITY, -INFINITY };
+    for (uint32_t index : indices) {
+        for (int axis = 0; axis < 3; axis++) {
+            min[axis] = std::min(min[axis], vertices[index].position[axis]);
+            max[axis] = std::max(max[axis], vertices[index].position[axis]);
+        }
+    }
+    Sphere sphere = { (min + max) * 0.5f, 0.0f };
+    for (uint32_t index : indices) sphere.radius = std::max(sphere.radius, length(vertices[index].position - sphere.center));
+    return sphere;
+}
+
+static bool read_file(const std::string& path, std::string& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::stringstream stream;
+    stream << file.rdbuf();
+    data = stream.str();
+    return true;
+}
+
+// wavefront obj: positions, optional normals, polygonal faces (fan triangulated)
+static Mesh load_obj(const std::string& data) {
+    Mesh mesh;
+    std::vector<Vec3> positions, normals;
+    std::unordered_map<uint64_t, uint32_t> vertexLookup; // (position, normal) index pair -> vertex
+    std::vector<bool> missingNormals;
+    std::vector<uint32_t> face;
+
+    const char* pLine = data.c_str();
+    const char* pEnd = pLine + data.size();
+    while (pLine < pEnd) {
+        const char* pNext = static_cast<const char*>(std::memchr(pLine, '\n', pEnd - pLine));
+        if (pNext == nullptr) pNext = pEnd;
+        std::string_view line = std::string_view(pLine, pNext - pLine);
+        char* pCursor = const_cast<char*>(pLine);
+
+        if (line.starts_with("v ") || line.starts_with("vn ")) {
+            pCursor += line[1] == 'n' ? 3 : 2;
+            Vec3 value;
+            for (float& component : value) component = std::strtof(pCursor, &pCursor);
+            (line[1] == 'n' ? normals : positions).push_back(value);
+        }
+        else if (line.starts_with("f ")) {
+            // corners as p, p/t, p//n or p/t/n with 1-based or negative (relative) indices
+            face.clear();
+            pCursor += 2;
+            while (pCursor < pNext) {
+                while (pCursor < pNext && (*pCursor == ' ' || *pCursor == '\t' || *pCursor == '\r')) pCursor++;
+                if (pCursor >= pNext) break;
+                long p = std::strtol(pCursor, &pCursor, 10), n = 0;
+                if (*pCursor == '/') {
+                    pCursor++;
+                    if (*pCursor != '/') std::strtol(pCursor, &pCursor, 10);
+                    if (*pCursor == '/') n = std::strtol(pCursor + 1, &pCursor, 10);
+                }
+                int64_t position = p < 0 ? (int64_t)positions.size() + p : p - 1;
+                int64_t normal = n < 0 ? (int64_t)normals.size() + n : n - 1;
+                if (position < 0 || position >= (int64_t)positions.size()) break;
+                if (normal >= (int64_t)normals.size()) normal = -1;
+
+                uint64_t key = (uint64_t)position << 32 | (uint32_t)(normal + 1);
+                auto [it, bInserted] = vertexLookup.try_emplace(key, (uint32_t)mesh.vertices.size());
+                if (bInserted) {
+                    mesh.vertices.push_back({ positions[position], normal < 0 ? Vec3{} : normals[normal] });
+                    missingNormals.push_back(normal < 0);
+                }
+                face.push_back(it->second);
+            }
+            for (uint32_t i = 2; i < face.size(); i++) mesh.indices.insert(mesh.indices.end(), { face[0], face[i - 1], face[i] });
+        }
+        pLine = pNext + 1;
+    }
+
+    // area weighted face normals for vertices without one
+    for (uint32_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        Vertex& a = mesh.vertices[mesh.indices[i]];
+        Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+        Vertex& c = mesh.vertices[mesh.indices[i + 2]];
+        Vec3 normal = cross(b.position - a.position, c.position - a.position);
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            uint32_t index = mesh.indices[i + corner];
+            if (missingNormals[index]) mesh.vertices[index].normal = mesh.vertices[index].normal + normal;
+        }
+    }
+    for (uint32_t i = 0; i < mesh.vertices.size(); i++) {
+        if (missingNormals[i]) mesh.vertices[i].normal = normalize(mesh.vertices[i].normal);
+    }
+    return mesh;
+}
+
+// stereolithography, binary or ascii, with flat shaded facets
+static Mesh load_stl(const std::string& data) {
+    Mesh mesh;
+    struct KeyHash {
+        size_t operator()(const std::array<uint32_t, 6>& key) const {
+            size_t hash = 14695981039346656037ull;
+            for (uint32_t value : key) hash = (hash ^ value) * 1099511628211ull;
+            return hash;
+        }
+    };
+    std::unordered_map<std::array<uint32_t, 6>, uint32_t, KeyHash> vertexLookup;
+    auto add_facet = [&](Vec3 normal, const std::array<Vec3, 3>& corners) {
+        if (length(normal) == 0.0f) normal = cross(corners[1] - corners[0], corners[2] - corners[0]);
+        normal = normalize(normal);
+        for (const Vec3& corner : corners) {
+            std::array<uint32_t, 6> key;
+            for (int axis = 0; axis < 3; axis++) {
+                key[axis] = std::bit_cast<uint32_t>(corner[axis]);
+                key[axis + 3] = std::bit_cast<uint32_t>(normal[axis]);
+            }
+            auto [it, bInserted] = vertexLookup.try_emplace(key, (uint32_t)mesh.vertices.size());
+            if (bInserted) mesh.vertices.push_back({ corner, normal });
+            mesh.indices.push_back(it->second);
+        }
+    };
+
+    // binary files may also start with "solid", so the size decides
+    uint32_t nTriangles = 0;
+    if (data.size() >= 84) std::memcpy(&nTriangles, data.data() + 80, sizeof(uint32_t));
+    if (data.size() >= 84 && data.size() == 84 + (size_t)nTriangles * 50) {
+        for (uint32_t i = 0; i < nTriangles; i++) {
+            std::array<float, 12> values;
+            std::memcpy(values.data(), data.data() + 84 + (size_t)i * 50, sizeof(values));
+            add_facet({ values[0], values[1], values[2] }, {
+                Vec3{ values[3], values[4], values[5] }, Vec3{ values[6], values[7], values[8] }, Vec3{ values[9], values[10], values[11] } });
+        }
+        return mesh;
+    }
+    std::stringstream stream = std::stringstream(data);
+    Vec3 normal = {};
+    std::array<Vec3, 3> corners;
+    uint32_t nCorners = 0;
+    for (std::string token; stream >> token;) {
+        if (token == "normal") stream >> normal[0] >> normal[1] >> normal[2];
+        else if (token == "vertex" && nCorners < 3) {
+            Vec3& corner = corners[nCorners++];
+            stream >> corner[0] >> corner[1] >> corner[2];
+        }
+        else if (token == "endfacet") {
+            if (nCorners == 3) add_facet(normal, corners);
+            nCorners = 0;
+        }
+    }
+    return mesh;
+}
+
+// merges all vertices within a grid cell into the first one, dropping collapsed triangles
+// cells need a positive size, degenerate meshes get no lods
+static std::vector<uint32_t> simplify(const Mesh& mesh, float cellSize, Vec3 origin) {
+    if (!(cellSize > 0.0f)) return {};
+    std::unordered_map<uint64_t, uint32_t> cells;
+    std::vector<uint32_t> remap(mesh.vertices.size());
+    for (uint32_t i = 0; i < mesh.vertices.size(); i++) {
+        uint64_t key = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            uint64_t cell = (uint64_t)((mesh.vertices[i].position[axis] - origin[axis]) / cellSize);
+            key |= (cell & 0x1fffff) << (axis * 21);
+        }
+        remap[i] = cells.try_emplace(key, i).first->second;
+    }
+    std::vector<uint32_t> indices;
+    for (uint32_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        uint32_t a = remap[mesh.indices[i]], b = remap[mesh.indices[i + 1]], c = remap[mesh.indices[i + 2]];
+        if (a == b || b == c || a == c) continue;
+        indices.insert(indices.end(), { a, b, c });
+    }
+    return indices;
+}
+
+static std::vector<MeshFile::Meshlet> build_meshlets(const Mesh& mesh) {
+    constexpr uint32_t maxVertices = 64, maxTriangles = 124;
+    std::vector<MeshFile::Meshlet> meshlets;
+    std::vector<uint32_t> unique;
+    uint32_t first = 0;
+    auto flush = [&](uint32_t end) {
+        if (end == first) return;
+        Sphere sphere = bounding_sphere(mesh.vertices, std::span(mesh.indices).subspan(first, end - first));
+        meshlets.push_back({ first, end - first, (uint32_t)unique.size(), 0,
+            { sphere.center[0], sphere.center[1], sphere.center[2], sphere.radius } });
+        unique.clear();
+        first = end;
+    };
+    for (uint32_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        uint32_t nNew = 0;
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            nNew += std::find(unique.begin(), unique.end(), mesh.indices[i + corner]) == unique.end();
+        }
+        if (unique.size() + nNew > maxVertices || (i - first) / 3 + 1 > maxTriangles) flush(i);
+        for (uint32_t corner = 0; corner < 3; corner++) {
+            uint32_t index = mesh.indices[i + corner];
+            if (std::find(unique.begin(), unique.end(), index) == unique.end()) unique.push_back(index);
+        }
+    }
+    flush(mesh.indices.size());
+    return meshlets;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fmt::println("usage: vulkan-renderer-meshconv <input.obj|input.stl> <output.mesh> [--lods N]");
+        return 1;
+    }
+    std::string inputPath = argv[1], outputPath = argv[2];
+    uint32_t nLods = 4;
+    for (int i = 3; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--lods" && i + 1 < argc) nLods = std::clamp<uint32_t>(std::strtoul(argv[++i], nullptr, 10), 1, 8);
+        else fmt::println("unknown argument: {}", arg);
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // parse input
+    std::string data;
+    if (!read_file(inputPath, data)) {
+        fmt::println("could not open input: {}", inputPath);
+        return 1;
+    }
+    std::string extension = inputPath.substr(inputPath.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return std::tolower(c); });
+    Mesh mesh;
+    if (extension == "obj") mesh = load_obj(data);
+    else if (extension == "stl") mesh = load_stl(data);
+    else {
+        fmt::println("unsupported input format: {}", extension);
+        return 1;
+    }
+    if (mesh.indices.empty()) {
+        fmt::println("no triangles in input: {}", inputPath);
+        return 1;
+    }
+    Sphere sphere = bounding_sphere(mesh.vertices, mesh.indices);
+    // all vertices in one point (or non-finite positions) cannot be culled, clustered or drawn
+    if (!(sphere.radius > 0.0f) || !std::isfinite(sphere.radius)) {
+        fmt::println("input has no extent: {}", inputPath);
+        return 1;
+    }
+
+    // lod 0 is the input, every further lod halves the clustering grid resolution
+    std::vector<MeshFile::Lod> lods = { { 0, (uint32_t)mesh.indices.size(), 0.0f, 0 } };
+    std::vector<uint32_t> indices = mesh.indices;
+    Vec3 origin = sphere.center - Vec3{ sphere.radius, sphere.radius, sphere.radius };
+    for (uint32_t lod = 1; lod < nLods; lod++) {
+        float cellSize = 2.0f * sphere.radius / (float)(512u >> lod);
+        std::vector<uint32_t> lodIndices = simplify(mesh, cellSize, origin);
+        if (lodIndices.empty() || lodIndices.size() >= lods.back().indexCount) break;
+        lods.push_back({ (uint32_t)indices.size(), (uint32_t)lodIndices.size(), cellSize, 0 });
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+    }
+    std::vector<MeshFile::Meshlet> meshlets = build_meshlets(mesh);
+
+    // lay out blocks
+    MeshFile::Header header = {
+        .magic = MeshFile::magic,
+        .version = MeshFile::version,
+        .vertexStride = sizeof(Vertex),
+        .vertexCount = (uint32_t)mesh.vertices.size(),
+        .indexCount = (uint32_t)indices.size(),
+        .lodCount = (uint32_t)lods.size(),
+        .meshletCount = (uint32_t)meshlets.size(),
+        .sphere = { sphere.center[0], sphere.center[1], sphere.center[2], sphere.radius },
+    };
+    uint64_t offset = MeshFile::align(sizeof(MeshFile::Header));
+    for (auto [pBlock, size] : {
+            std::pair(&header.lods, std::span(lods).size_bytes()), std::pair(&header.meshlets, std::span(meshlets).size_bytes()),
+            std::pair(&header.vertices, std::span(mesh.vertices).size_bytes()), std::pair(&header.indices, std::span(indices).size_bytes()) }) {
+        *pBlock = { offset, size };
+        offset = MeshFile::align(offset + size);
+    }
+
+    // write header and blocks with zero padding in between
+    std::ofstream file(outputPath, std::ios::binary);
+    if (!file) {
+        fmt::println("could not open output: {}", outputPath);
+        return 1;
+    }
+    auto write_block = [&](MeshFile::Block block, const void* pData) {
+        std::vector<char> padding(block.offset - (uint64_t)file.tellp(), 0);
+        file.write(padding.data(), padding.size());
+        file.write(static_cast<const char*>(pData), block.size);
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_block(header.lods, lods.data());
+    write_block(header.meshlets, meshlets.data());
+    write_block(header.vertices, mesh.vertices.data());
+    write_block(header.indices, indices.data());
+    if (!file) {
+        fmt::println("could not write output: {}", outputPath);
+        return 1;
+    }
+
+    float time = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    fmt::println("{}: {} vertices, {} meshlets, {} bytes in {:.2f} ms", outputPath, header.vertexCount, header.meshletCount, offset, time);
+    for (uint32_t i = 0; i < lods.size(); i++) fmt::println("\tlod {}: {} triangles, error {:.4f}", i, lods[i].indexCount / 3, lods[i].error);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <fmt/base.h>
+//
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+//
+#include "metrics.hpp"
+
+// reads the live metrics a running renderer publishes with --metrics, never blocks the render thread
+// usage: vulkan-renderer-metrics [--name /vulkan-renderer-metrics] [--watch ms] [--json]
+
+// upper bound of the bucket holding the given quantile, the overflow bucket reports the previous bound
+static double quantile(const Metrics::Sample& sample, double q) {
+    uint64_t target = (uint64_t)(q * (double)sample.count + 0.5);
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < Metrics::nBuckets; i++) {
+        total += sample.buckets[i];
+        if (total >= target && total > 0) return i + 1 < Metrics::nBuckets ? sample.bounds[i] : sample.bounds[i - 1];
+    }
+    return 0.0;
+}
+
+static void print_text(const Metrics::Segment& segment, double age) {
+    fmt::println("pid {}, published {:.2f}s ago", segment.pid, age);
+    for (uint32_t i = 0; i < segment.nSamples; i++) {
+        const Metrics::Sample& sample = segment.samples[i];
+        switch (sample.type) {
+            case Metrics::Type::eCounter:
+                fmt::println("  {:<28} {:>14.0f}", sample.name, sample.value);
+                break;
+            case Metrics::Type::eGauge:
+                fmt::println("  {:<28} {:>14.3f}", sample.name, sample.value);
+                break;
+            case Metrics::Type::eHistogram: {
+                double mean = sample.count > 0 ? sample.value / (double)sample.count : 0.0;
+                fmt::println("  {:<28} n={} mean={:.3f} p50<={} p99<={}", sample.name, sample.count, mean, quantile(sample, 0.5), quantile(sample, 0.99));
+                break;
+            }
+        }
+    }
+}
+
+static void print_json(const Metrics::Segment& segment, double age) {
+    fmt::print("{{\"pid\": {}, \"age\": {:.3f}, \"metrics\": {{", segment.pid, age);
+    for (uint32_t i = 0; i < segment.nSamples; i++) {
+        const Metrics::Sample& sample = segment.samples[i];
+        fmt::print("{}\"{}\": ", i > 0 ? ", " : "", sample.name);
+        if (sample.type != Metrics::Type::eHistogram) {
+            fmt::print("{}", sample.value);
+            continue;
+        }
+        fmt::print("{{\"count\": {}, \"sum\": {}, \"p50\": {}, \"p99\": {}, \"buckets\": [", sample.count, sample.value, quantile(sample, 0.5), quantile(sample, 0.99));
+        for (uint32_t b = 0; b < Metrics::nBuckets; b++) fmt::print("{}[{}, {}]", b > 0 ? ", " : "", sample.bounds[b], sample.buckets[b]);
+        fmt::print("]}}");
+    }
+    fmt::println("}}}}");
+}
+
+int main(int argc, char** argv) {
+    std::string name = std::string(Metrics::defaultName);
+    uint32_t watchMs = 0;
+    bool bJson = false;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--name" && i + 1 < argc) name = argv[++i];
+        else if (arg == "--watch" && i + 1 < argc) watchMs = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--json") bJson = true;
+        else {
+            fmt::println("usage: vulkan-renderer-metrics [--name /vulkan-renderer-metrics] [--watch ms] [--json]");
+            return 1;
+        }
+    }
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        fmt::println("no metrics published at {}, start the renderer with --metrics", name);
+        return 1;
+    }
+    void* pMap = mmap(nullptr, sizeof(Metrics::Segment), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (pMap == MAP_FAILED) {
+        fmt::println("could not map {}", name);
+        return 1;
+    }
+    const Metrics::Segment& segment = *static_cast<const Metrics::Segment*>(pMap);
+
+    static Metrics::Segment copy; // too large for the stack on some systems
+    do {
+        if (!Metrics::read(segment, copy)) {
+            fmt::println("metrics kept changing while reading");
+        }
+        else if (copy.magic != Metrics::magic || copy.version != Metrics::version) {
+            fmt::println("unexpected metrics layout (version {}, expected {})", copy.version, Metrics::version);
+            return 1;
+        }
+        else {
+            auto now = std::chrono::system_clock::now().time_since_epoch();
+            double age = (double)(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() - (int64_t)copy.publishTime) * 1e-9;
+            if (bJson) print_json(copy, age);
+            else print_text(copy, age);
+        }
+        if (watchMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(watchMs));
+    } while (watchMs > 0);
+    munmap(pMap, sizeof(Metrics::Segment));
+    return 0;
+}